@@ -39,6 +39,9 @@
 #include <vm.h>
 #include <mainbus.h>
 #include <syscall.h>
+#include <counter.h>
+
+static struct counter vmfault_counter = COUNTER_INITIALIZER("vm faults");
 
 
 /* in exception-*.S */
@@ -157,6 +160,8 @@ mips_trap(struct trapframe *tf)
 
 		old_in = curthread->t_in_interrupt;
 		curthread->t_in_interrupt = 1;
+		/* for hardclock's user/system time accounting */
+		curthread->t_intr_user = !iskern;
 
 		/*
 		 * The processor has turned interrupts off; if the
@@ -233,16 +238,22 @@ mips_trap(struct trapframe *tf)
 	 */
 	switch (code) {
 	case EX_MOD:
+		curthread->t_usage.tu_nfaults++;
+		counter_inc(&vmfault_counter);
 		if (vm_fault(VM_FAULT_READONLY, tf->tf_vaddr)==0) {
 			goto done;
 		}
 		break;
 	case EX_TLBL:
+		curthread->t_usage.tu_nfaults++;
+		counter_inc(&vmfault_counter);
 		if (vm_fault(VM_FAULT_READ, tf->tf_vaddr)==0) {
 			goto done;
 		}
 		break;
 	case EX_TLBS:
+		curthread->t_usage.tu_nfaults++;
+		counter_inc(&vmfault_counter);
 		if (vm_fault(VM_FAULT_WRITE, tf->tf_vaddr)==0) {
 			goto done;
 		}
@@ -35,7 +35,296 @@
 #include <thread.h>
 #include <current.h>
 #include <syscall.h>
+#include <counter.h>
+#include <cpu.h>
+#include <spl.h>
+#include <clock.h>
 
+static struct counter syscall_counter = COUNTER_INITIALIZER("syscalls");
+static struct counter syscall_unknown_counter =
+	COUNTER_INITIALIZER("unknown syscalls");
+
+/*
+ * Argument marshalling: each of these unpacks the trapframe for one
+ * system call and calls the in-kernel implementation. They return an
+ * error code and leave the return value (if any) in *retval.
+ */
+
+static
+int
+sc_reboot(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys_reboot(tf->tf_a0);
+}
+
+static
+int
+sc_time(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys___time((userptr_t)tf->tf_a0, (userptr_t)tf->tf_a1);
+}
+
+static
+int
+sc_getpid(struct trapframe *tf, int32_t *retval)
+{
+	(void)tf;
+	sys_getpid(retval);
+	//always successful 
+	return 0;
+}
+
+static
+int
+sc_fork(struct trapframe *tf, int32_t *retval)
+{
+	//also pass whole frame so it can be copied into new process
+	return sys_fork(tf, retval);
+}
+
+static
+int
+sc_execv(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys_execv((char *)tf->tf_a0, (char **)tf->tf_a1);
+}
+
+static
+int
+sc_exit(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	sys__exit(tf->tf_a0);
+	return 0;
+}
+
+static
+int
+sc_waitpid(struct trapframe *tf, int32_t *retval)
+{
+	return sys_waitpid(tf->tf_a0, (userptr_t)tf->tf_a1, tf->tf_a2, retval);
+}
+
+static
+int
+sc_getrusage(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys_getrusage(tf->tf_a0, (userptr_t)tf->tf_a1);
+}
+
+static
+int
+sc_getpriority(struct trapframe *tf, int32_t *retval)
+{
+	return sys_getpriority(tf->tf_a0, tf->tf_a1, retval);
+}
+
+static
+int
+sc_setpriority(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys_setpriority(tf->tf_a0, tf->tf_a1, tf->tf_a2);
+}
+
+static
+int
+sc_futex(struct trapframe *tf, int32_t *retval)
+{
+	return sys_futex((userptr_t)tf->tf_a0, tf->tf_a1, tf->tf_a2, retval);
+}
+
+static
+int
+sc_sysring_enter(struct trapframe *tf, int32_t *retval)
+{
+	return sys_sysring_enter((userptr_t)tf->tf_a0, tf->tf_a1, retval);
+}
+
+static
+int
+sc_printchar(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys_printchar((const_userptr_t)tf->tf_a0);
+}
+
+/*
+ * The dispatch table, indexed by call number. Calls with no handler
+ * get ENOSYS. se_batch says whether the call may be made through
+ * sysring_enter, which rules out ones that don't return to the caller
+ * or that need the real trapframe. se_slot is the entry's index in
+ * each cpu's c_syscallstat[], handed out by syscall_bootstrap.
+ */
+struct syscall_entry {
+	const char *se_name;
+	int (*se_func)(struct trapframe *tf, int32_t *retval);
+	bool se_batch;
+	unsigned se_slot;
+};
+
+static struct syscall_entry syscall_table[] = {
+	[SYS_fork] =          { "fork",          sc_fork,           false, 0 },
+	[SYS_execv] =         { "execv",         sc_execv,          false, 0 },
+	[SYS__exit] =         { "_exit",         sc_exit,           false, 0 },
+	[SYS_waitpid] =       { "waitpid",       sc_waitpid,        true,  0 },
+	[SYS_getpid] =        { "getpid",        sc_getpid,         true,  0 },
+	[SYS_getrusage] =     { "getrusage",     sc_getrusage,      true,  0 },
+	[SYS_getpriority] =   { "getpriority",   sc_getpriority,    true,  0 },
+	[SYS_setpriority] =   { "setpriority",   sc_setpriority,    true,  0 },
+	[SYS___time] =        { "__time",        sc_time,           true,  0 },
+	[SYS_reboot] =        { "reboot",        sc_reboot,         true,  0 },
+	[SYS_printchar] =     { "printchar",     sc_printchar,      true,  0 },
+	[SYS_futex] =         { "futex",         sc_futex,          true,  0 },
+	[SYS_sysring_enter] = { "sysring_enter", sc_sysring_enter,  false, 0 },
+};
+
+/*
+ * Stats state. syscall_statgen is bumped by syscall_stats_reset; a
+ * cpu whose c_syscallstat_gen is behind clears its own stats before
+ * touching them again, so resetting never writes another cpu's.
+ */
+static volatile bool syscall_timing;
+static volatile unsigned syscall_statgen;
+
+void
+syscall_bootstrap(void)
+{
+	unsigned i, slot;
+
+	slot = 0;
+	for (i=0; i<ARRAYCOUNT(syscall_table); i++) {
+		if (syscall_table[i].se_func == NULL) {
+			continue;
+		}
+		if (slot == SYSCALL_NSTATS) {
+			panic("syscall: too many calls for SYSCALL_NSTATS\n");
+		}
+		syscall_table[i].se_slot = slot++;
+	}
+}
+
+/*
+ * Get this cpu's stats for SE, clearing out stale ones. Interrupts
+ * must be off so we stay on this cpu.
+ */
+static
+struct syscallstat *
+syscall_mystat(const struct syscall_entry *se)
+{
+	struct cpu *c = curcpu->c_self;
+
+	if (c->c_syscallstat_gen != syscall_statgen) {
+		bzero(c->c_syscallstat, sizeof(c->c_syscallstat));
+		c->c_syscallstat_gen = syscall_statgen;
+	}
+	return &c->c_syscallstat[se->se_slot];
+}
+
+/*
+ * Count a call on the way in, so ones that don't come back (_exit,
+ * a successful execv) are counted too.
+ */
+static
+void
+syscall_stat_enter(const struct syscall_entry *se)
+{
+	int spl;
+
+	spl = splhigh();
+	syscall_mystat(se)->ss_calls++;
+	splx(spl);
+}
+
+/*
+ * Record the outcome of a call, and how long it took if START is
+ * not NULL.
+ */
+static
+void
+syscall_stat_leave(const struct syscall_entry *se, int err,
+		   const struct timespec *start)
+{
+	struct syscallstat *ss;
+	struct timespec now, took;
+	unsigned usec, bucket;
+	int spl;
+
+	usec = 0;
+	if (start != NULL) {
+		gettime(&now);
+		timespec_sub(&now, start, &took);
+		if (took.tv_sec < 0) {
+			/* clock went backwards?! */
+			start = NULL;
+		}
+		else if (took.tv_sec >= 4000) {
+			/* don't overflow */
+			usec = 4000000000U;
+		}
+		else {
+			usec = took.tv_sec * 1000000 + took.tv_nsec / 1000;
+		}
+	}
+
+	bucket = 0;
+	while (bucket < SYSCALL_HISTBUCKETS - 1 && (usec >> (bucket + 1)) != 0) {
+		bucket++;
+	}
+
+	spl = splhigh();
+	ss = syscall_mystat(se);
+	if (err) {
+		ss->ss_errors++;
+	}
+	if (start != NULL) {
+		ss->ss_usec += usec;
+		ss->ss_hist[bucket]++;
+	}
+	splx(spl);
+}
+
+
+/*
+ * Look up a call number; NULL if there's no such call.
+ */
+static
+const struct syscall_entry *
+syscall_lookup(int callno)
+{
+	if (callno < 0 || (unsigned)callno >= ARRAYCOUNT(syscall_table) ||
+	    syscall_table[callno].se_func == NULL) {
+		counter_inc(&syscall_unknown_counter);
+		return NULL;
+	}
+	return &syscall_table[callno];
+}
+
+/*
+ * Call SE's handler, keeping the stats.
+ */
+static
+int
+syscall_dispatch(const struct syscall_entry *se, struct trapframe *tf,
+		 int32_t *retval)
+{
+	struct timespec start;
+	bool timed;
+	int err;
+
+	timed = syscall_timing;
+	if (timed) {
+		gettime(&start);
+	}
+	syscall_stat_enter(se);
+	err = se->se_func(tf, retval);
+	syscall_stat_leave(se, err, timed ? &start : NULL);
+	return err;
+}
 
 /*
  * System call dispatcher.
@@ -81,12 +370,14 @@ syscall(struct trapframe *tf)
 	int callno;
 	int32_t retval;
 	int err;
+	const struct syscall_entry *se;
 
 	KASSERT(curthread != NULL);
 	KASSERT(curthread->t_curspl == 0);
 	KASSERT(curthread->t_iplhigh_count == 0);
 
 	callno = tf->tf_v0;
+	counter_inc(&syscall_counter);
 
 	/*
 	 * Initialize retval to 0. Many of the system calls don't
@@ -99,52 +390,13 @@ syscall(struct trapframe *tf)
 
 	retval = 0;
 
-	switch (callno) {
-	    case SYS_reboot:
-		err = sys_reboot(tf->tf_a0);
-		break;
-
-	    case SYS___time:
-		err = sys___time((userptr_t)tf->tf_a0,
-				 (userptr_t)tf->tf_a1);
-		break;
-            case SYS_getpid:
-		err = sys_getpid(&retval);
-		//always successful 
-		err = 0;
-		break;
-            case SYS_fork:
-		
-		//also pass whole frame so it can be copied into new process
-		err = sys_fork(tf, &retval);
-		break;
-
-  	    case SYS_execv:
-		err = sys_execv((char *)tf->tf_a0,
-				(char **)tf->tf_a1);
-		break;
-		  
-            case SYS__exit:
-		err = 0;
-		sys__exit(tf->tf_a0);
-		break;
-
-	    case SYS_waitpid:
-		err = sys_waitpid(tf->tf_a0,
-				  (userptr_t)tf->tf_a1,
-				  tf->tf_a2, &retval);
-		break;
-	    case SYS_printchar:
-		kprintf((const char *)tf->tf_a0);
-		break;
-	//  case SYS_myprintf:
-	//	kprintf((const char *)tf->tf_a0);
-	    default:
-		kprintf("Unknown syscall %d\n", callno);
+	se = syscall_lookup(callno);
+	if (se == NULL) {
 		err = ENOSYS;
-		break;
 	}
-
+	else {
+		err = syscall_dispatch(se, tf, &retval);
+	}
 
 	if (err) {
 		/*
@@ -174,6 +426,32 @@ syscall(struct trapframe *tf)
 	KASSERT(curthread->t_iplhigh_count == 0);
 }
 
+/*
+ * Run one call for sysring_enter. The handlers only look at the
+ * argument registers, so a scratch trapframe holding those will do.
+ */
+int
+syscall_batch(int callno, const int32_t *args, int32_t *retval)
+{
+	const struct syscall_entry *se;
+	struct trapframe tf;
+
+	se = syscall_lookup(callno);
+	if (se == NULL || !se->se_batch) {
+		return ENOSYS;
+	}
+
+	bzero(&tf, sizeof(tf));
+	tf.tf_v0 = callno;
+	tf.tf_a0 = args[0];
+	tf.tf_a1 = args[1];
+	tf.tf_a2 = args[2];
+	tf.tf_a3 = args[3];
+
+	*retval = 0;
+	return syscall_dispatch(se, &tf, retval);
+}
+
 /*
  * Enter user mode for a newly forked process.
  *
@@ -205,3 +483,72 @@ enter_forked_process(void *tframe, unsigned long junk)
 	/* Warp out of this strange land */
 	mips_usermode(&child_tf);
 }
+
+/*
+ * Turn syscall timing on or off.
+ */
+void
+syscall_timing_enable(bool on)
+{
+	syscall_timing = on;
+}
+
+/*
+ * Print the stats for every call that has been made since the last
+ * reset, with the latency histogram of the timed ones.
+ */
+void
+syscall_stats_print(void)
+{
+	struct syscallstat ss;
+	const struct syscall_entry *se;
+	unsigned i, j, timed;
+
+	kprintf("Syscall timing is %s\n", syscall_timing ? "on" : "off");
+	kprintf("%-12s %10s %10s %14s %10s\n",
+		"syscall", "calls", "errors", "usec", "avg usec");
+	for (i=0; i<ARRAYCOUNT(syscall_table); i++) {
+		se = &syscall_table[i];
+		if (se->se_func == NULL) {
+			continue;
+		}
+		cpu_syscallstat_sum(se->se_slot, syscall_statgen, &ss);
+		if (ss.ss_calls == 0) {
+			continue;
+		}
+
+		timed = 0;
+		for (j=0; j<SYSCALL_HISTBUCKETS; j++) {
+			timed += ss.ss_hist[j];
+		}
+		kprintf("%-12s %10u %10u %14llu %10llu\n", se->se_name,
+			ss.ss_calls, ss.ss_errors,
+			(unsigned long long)ss.ss_usec,
+			timed ? (unsigned long long)ss.ss_usec / timed : 0ULL);
+
+		for (j=0; j<SYSCALL_HISTBUCKETS; j++) {
+			if (ss.ss_hist[j] == 0) {
+				continue;
+			}
+			if (j == SYSCALL_HISTBUCKETS - 1) {
+				kprintf("    %10u+     usec: %u\n",
+					1U << j, ss.ss_hist[j]);
+			}
+			else {
+				kprintf("    %10u-%-10u usec: %u\n",
+					j == 0 ? 0 : 1U << j,
+					(1U << (j + 1)) - 1, ss.ss_hist[j]);
+			}
+		}
+	}
+}
+
+/*
+ * Clear the stats. Each cpu notices the new generation and zeroes its
+ * own the next time it makes a system call.
+ */
+void
+syscall_stats_reset(void)
+{
+	syscall_statgen++;
+}
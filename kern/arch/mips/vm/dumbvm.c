@@ -29,6 +29,7 @@
 
 #include <types.h>
 #include <kern/errno.h>
+#include <kern/kinfo.h>
 #include <lib.h>
 #include <spl.h>
 #include <cpu.h>
@@ -38,6 +39,7 @@
 #include <mips/tlb.h>
 #include <addrspace.h>
 #include <vm.h>
+#include <clock.h>
 
 /*
  * Dumb MIPS-only "VM system" that is intended to only be just barely
@@ -62,7 +64,7 @@
 /*
  * Wrap ram_stealmem in a spinlock.
  */
-static struct spinlock stealmem_lock = SPINLOCK_INITIALIZER;
+static struct spinlock stealmem_lock = SPINLOCK_INITIALIZER_TICKET(NULL);
 
 void
 vm_bootstrap(void)
@@ -136,7 +138,6 @@ vm_tlbshootdown(const struct tlbshootdown *ts)
 int
 vm_fault(int faulttype, vaddr_t faultaddress)
 {
-	vaddr_t vbase1, vtop1, vbase2, vtop2, stackbase, stacktop;
 	paddr_t paddr;
 	int i;
 	uint32_t ehi, elo;
@@ -149,10 +150,14 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 
 	switch (faulttype) {
 	    case VM_FAULT_READONLY:
-		/* We always create pages read-write, so we can't get this */
-		panic("dumbvm: got VM_FAULT_READONLY\n");
+		/* Only the kinfo pages are mapped read-only */
+		return EFAULT;
 	    case VM_FAULT_READ:
+		break;
 	    case VM_FAULT_WRITE:
+		if (faultaddress == KINFO_PROC || faultaddress == KINFO_CLOCK) {
+			return EFAULT;
+		}
 		break;
 	    default:
 		return EINVAL;
@@ -184,29 +189,14 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 	KASSERT(as->as_pbase2 != 0);
 	KASSERT(as->as_npages2 != 0);
 	KASSERT(as->as_stackpbase != 0);
+	KASSERT(as->as_kinfopbase != 0);
 	KASSERT((as->as_vbase1 & PAGE_FRAME) == as->as_vbase1);
 	KASSERT((as->as_pbase1 & PAGE_FRAME) == as->as_pbase1);
 	KASSERT((as->as_vbase2 & PAGE_FRAME) == as->as_vbase2);
 	KASSERT((as->as_pbase2 & PAGE_FRAME) == as->as_pbase2);
 	KASSERT((as->as_stackpbase & PAGE_FRAME) == as->as_stackpbase);
 
-	vbase1 = as->as_vbase1;
-	vtop1 = vbase1 + as->as_npages1 * PAGE_SIZE;
-	vbase2 = as->as_vbase2;
-	vtop2 = vbase2 + as->as_npages2 * PAGE_SIZE;
-	stackbase = USERSTACK - DUMBVM_STACKPAGES * PAGE_SIZE;
-	stacktop = USERSTACK;
-
-	if (faultaddress >= vbase1 && faultaddress < vtop1) {
-		paddr = (faultaddress - vbase1) + as->as_pbase1;
-	}
-	else if (faultaddress >= vbase2 && faultaddress < vtop2) {
-		paddr = (faultaddress - vbase2) + as->as_pbase2;
-	}
-	else if (faultaddress >= stackbase && faultaddress < stacktop) {
-		paddr = (faultaddress - stackbase) + as->as_stackpbase;
-	}
-	else {
+	if (as_translate(as, faultaddress, &paddr)) {
 		return EFAULT;
 	}
 
@@ -222,7 +212,10 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 			continue;
 		}
 		ehi = faultaddress;
-		elo = paddr | TLBLO_DIRTY | TLBLO_VALID;
+		elo = paddr | TLBLO_VALID;
+		if (faultaddress != KINFO_PROC && faultaddress != KINFO_CLOCK) {
+			elo |= TLBLO_DIRTY;
+		}
 		DEBUG(DB_VM, "dumbvm: 0x%x -> 0x%x\n", faultaddress, paddr);
 		tlb_write(ehi, elo, i);
 		splx(spl);
@@ -249,6 +242,7 @@ as_create(void)
 	as->as_pbase2 = 0;
 	as->as_npages2 = 0;
 	as->as_stackpbase = 0;
+	as->as_kinfopbase = 0;
 
 	return as;
 }
@@ -341,6 +335,7 @@ as_prepare_load(struct addrspace *as)
 	KASSERT(as->as_pbase1 == 0);
 	KASSERT(as->as_pbase2 == 0);
 	KASSERT(as->as_stackpbase == 0);
+	KASSERT(as->as_kinfopbase == 0);
 
 	dumbvm_can_sleep();
 
@@ -359,9 +354,15 @@ as_prepare_load(struct addrspace *as)
 		return ENOMEM;
 	}
 
+	as->as_kinfopbase = getppages(1);
+	if (as->as_kinfopbase == 0) {
+		return ENOMEM;
+	}
+
 	as_zero_region(as->as_pbase1, as->as_npages1);
 	as_zero_region(as->as_pbase2, as->as_npages2);
 	as_zero_region(as->as_stackpbase, DUMBVM_STACKPAGES);
+	as_zero_region(as->as_kinfopbase, 1);
 
 	return 0;
 }
@@ -383,6 +384,41 @@ as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 	return 0;
 }
 
+int
+as_translate(struct addrspace *as, vaddr_t vaddr, paddr_t *ret)
+{
+	vaddr_t vbase1, vtop1, vbase2, vtop2, stackbase, stacktop;
+
+	vbase1 = as->as_vbase1;
+	vtop1 = vbase1 + as->as_npages1 * PAGE_SIZE;
+	vbase2 = as->as_vbase2;
+	vtop2 = vbase2 + as->as_npages2 * PAGE_SIZE;
+	stackbase = USERSTACK - DUMBVM_STACKPAGES * PAGE_SIZE;
+	stacktop = USERSTACK;
+
+	if (vaddr >= vbase1 && vaddr < vtop1) {
+		*ret = (vaddr - vbase1) + as->as_pbase1;
+	}
+	else if (vaddr >= vbase2 && vaddr < vtop2) {
+		*ret = (vaddr - vbase2) + as->as_pbase2;
+	}
+	else if (vaddr >= stackbase && vaddr < stacktop) {
+		*ret = (vaddr - stackbase) + as->as_stackpbase;
+	}
+	else if (vaddr >= KINFO_PROC && vaddr < KINFO_PROC + PAGE_SIZE &&
+		 as->as_kinfopbase != 0) {
+		*ret = (vaddr - KINFO_PROC) + as->as_kinfopbase;
+	}
+	else if (vaddr >= KINFO_CLOCK && vaddr < KINFO_CLOCK + PAGE_SIZE &&
+		 kinfo_clockpage() != 0) {
+		*ret = (vaddr - KINFO_CLOCK) + kinfo_clockpage();
+	}
+	else {
+		return EFAULT;
+	}
+	return 0;
+}
+
 int
 as_copy(struct addrspace *old, struct addrspace **ret)
 {
@@ -409,6 +445,7 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 	KASSERT(new->as_pbase1 != 0);
 	KASSERT(new->as_pbase2 != 0);
 	KASSERT(new->as_stackpbase != 0);
+	KASSERT(new->as_kinfopbase != 0);
 
 	memmove((void *)PADDR_TO_KVADDR(new->as_pbase1),
 		(const void *)PADDR_TO_KVADDR(old->as_pbase1),
@@ -425,3 +462,19 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 	*ret = new;
 	return 0;
 }
+
+/*
+ * The kinfo page isn't copied by as_copy; the pid it holds belongs to
+ * whoever set it up, so fork and exec fill it in here.
+ */
+void
+as_setkinfo(struct addrspace *as, pid_t pid, pid_t ppid)
+{
+	struct kinfo_proc *kp;
+
+	KASSERT(as->as_kinfopbase != 0);
+
+	kp = (struct kinfo_proc *)PADDR_TO_KVADDR(as->as_kinfopbase);
+	kp->kp_pid = pid;
+	kp->kp_ppid = ppid;
+}
@@ -91,20 +91,26 @@ SRCS.PLATFORM.sys161+=$(KTOP)/arch/mips/locore/exception-mips1.S
 SRCS.PLATFORM.sys161+=$(KTOP)/arch/mips/vm/tlb-mips161.S
 SRCS.PLATFORM.sys161+=$(KTOP)/arch/sys161/dev/lamebus_machdep.c
 SRCS.PLATFORM.sys161+=$(KTOP)/arch/sys161/main/start.S
+SRCS+=$(KTOP)/syscall/futex_syscalls.c
 SRCS+=$(KTOP)/syscall/loadelf.c
 SRCS+=$(KTOP)/syscall/process_syscalls.c
 SRCS+=$(KTOP)/syscall/runprogram.c
+SRCS+=$(KTOP)/syscall/sysring_syscalls.c
 SRCS+=$(KTOP)/syscall/time_syscalls.c
 SRCS+=$(KTOP)/test/arraytest.c
 SRCS+=$(KTOP)/test/bitmaptest.c
 SRCS+=$(KTOP)/test/fstest.c
 SRCS+=$(KTOP)/test/kmalloctest.c
+SRCS+=$(KTOP)/test/pidtest.c
 SRCS+=$(KTOP)/test/semunit.c
 SRCS+=$(KTOP)/test/synchtest.c
 SRCS+=$(KTOP)/test/threadlisttest.c
 SRCS+=$(KTOP)/test/threadtest.c
 SRCS+=$(KTOP)/test/tt3.c
 SRCS+=$(KTOP)/thread/clock.c
+SRCS+=$(KTOP)/thread/counter.c
+SRCS+=$(KTOP)/thread/lockstat.c
+SRCS+=$(KTOP)/thread/rcu.c
 SRCS+=$(KTOP)/thread/spinlock.c
 SRCS+=$(KTOP)/thread/spl.c
 SRCS+=$(KTOP)/thread/synch.c
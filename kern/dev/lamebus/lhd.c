@@ -60,6 +60,9 @@
 /* Buffer (offset within slot)  */
 #define LHD_BUFFER      32768
 
+/* How long to wait for one sector before giving up on the device (ms) */
+#define LHD_TIMEOUT     5000
+
 /*
  * Shortcut for reading a register.
  */
@@ -165,11 +168,8 @@ lhd_ioctl(struct device *d, int op, userptr_t data)
 	return EIOCTL;
 }
 
-#if 0
 /*
- * Reset the device.
- * This could be used, for instance, on timeout, if you implement suitable
- * facilities.
+ * Reset the device. This is used on timeout.
  */
 static
 void
@@ -177,7 +177,6 @@ lhd_reset(struct lhd_softc *lh)
 {
 	lhd_wreg(lh, LHD_REG_STAT, 0);
 }
-#endif
 
 /*
  * I/O function (for both reads and writes)
@@ -237,8 +236,21 @@ lhd_io(struct device *d, struct uio *uio)
 		/* and start the operation. */
 		lhd_wreg(lh, LHD_REG_STAT, statval);
 
-		/* Now wait until the interrupt handler tells us we're done. */
-		P(lh->lh_done);
+		/*
+		 * Now wait until the interrupt handler tells us we're
+		 * done. If it never does, reset the device, and soak
+		 * up any completion that raced with the reset so the
+		 * next request doesn't see it.
+		 */
+		if (P_timeout(lh->lh_done, LHD_TIMEOUT) == ETIMEDOUT) {
+			kprintf("lhd%d: timeout on sector %u\n",
+				lh->lh_unit, sector+i);
+			lhd_reset(lh);
+			while (P_timeout(lh->lh_done, 0) == 0) {
+				/* nothing */
+			}
+			lh->lh_result = EIO;
+		}
 
 		/* Get the result value saved by the interrupt handler. */
 		result = lh->lh_result;
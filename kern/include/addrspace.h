@@ -57,6 +57,7 @@ struct addrspace {
         paddr_t as_pbase2;
         size_t as_npages2;
         paddr_t as_stackpbase;
+        paddr_t as_kinfopbase;
 #else
         /* Put stuff here for your VM system */
 #endif
@@ -99,6 +100,14 @@ struct addrspace {
  *                (Normally called *after* as_complete_load().) Hands
  *                back the initial stack pointer for the new process.
  *
+ *    as_translate - look up the physical address that a user virtual
+ *                address maps to. Returns EFAULT if it isn't mapped.
+ *
+ *    as_setkinfo - fill in the address space's kinfo page (see
+ *                <kern/kinfo.h>) for the process with the given pid
+ *                and parent pid. Call after fork or exec has set up
+ *                the address space.
+ *
  * Note that when using dumbvm, addrspace.c is not used and these
  * functions are found in dumbvm.c.
  */
@@ -117,6 +126,9 @@ int               as_define_region(struct addrspace *as,
 int               as_prepare_load(struct addrspace *as);
 int               as_complete_load(struct addrspace *as);
 int               as_define_stack(struct addrspace *as, vaddr_t *initstackptr);
+int               as_translate(struct addrspace *as, vaddr_t vaddr,
+                               paddr_t *ret);
+void              as_setkinfo(struct addrspace *as, pid_t pid, pid_t ppid);
 
 
 /*
@@ -124,9 +136,17 @@ int               as_define_stack(struct addrspace *as, vaddr_t *initstackptr);
  *    load_elf - load an ELF user program executable into the current
  *               address space. Returns the entry point (initial PC)
  *               in the space pointed to by ENTRYPOINT.
+ *
+ *    execcache_bootstrap - allocate the executable image cache's
+ *               segment pool. Called once, after vm_bootstrap.
+ *
+ *    execcache_purge - drop all cached executable images, and with them
+ *               their vnode references. Called before unmounting.
  */
 
 int load_elf(struct vnode *v, vaddr_t *entrypoint);
+void execcache_bootstrap(void);
+void execcache_purge(void);
 
 
 #endif /* _ADDRSPACE_H_ */
@@ -54,11 +54,62 @@ void hardclock(void);
  */
 void timerclock(void);
 
+/*
+ * Timeouts. timeout_add arranges for FUNC(DATA) to be called from
+ * the timer interrupt on cpu 0 after TICKS hardclocks (at least one).
+ * FUNC runs in interrupt context with no locks held and must not
+ * sleep. timeout_cancel stops a pending timeout; if the timeout is
+ * firing right now, it waits for FUNC to finish, so once it returns
+ * the struct timeout may be reused or freed. It returns true if it
+ * stopped the timeout before it fired. Don't call timeout_cancel while
+ * holding a spinlock that FUNC takes.
+ *
+ * A struct timeout must be set up with timeout_init before first use
+ * and may not be added again while it is pending.
+ *
+ * timeout_npending counts the pending timeouts. It is meant to be used
+ * only for diagnostic purposes (the semaphore unit tests).
+ */
+struct timeout {
+	struct timeout *to_next;	/* next on the pending list */
+	unsigned to_expire;		/* tick at which to fire */
+	volatile unsigned to_state;	/* TO_IDLE, TO_PENDING, TO_FIRING */
+	void (*to_func)(void *);
+	void *to_data;
+};
+
+#define TO_IDLE		0
+#define TO_PENDING	1
+#define TO_FIRING	2
+
+/*
+ * Convert milliseconds to hardclocks, rounding up. Whole seconds are
+ * converted separately so that (ms) * HZ can't overflow for long waits.
+ * Uses DIVROUNDUP from lib.h.
+ */
+#define MS_TO_TICKS(ms) \
+	((ms) / 1000 * HZ + DIVROUNDUP((ms) % 1000 * HZ, 1000))
+
+void timeout_init(struct timeout *to);
+void timeout_add(struct timeout *to, unsigned ticks,
+		 void (*func)(void *), void *data);
+bool timeout_cancel(struct timeout *to);
+unsigned timeout_npending(void);
+
 /*
  * gettime() may be used to fetch the current time of day.
  */
 void gettime(struct timespec *ret);
 
+/*
+ * The shared kinfo clock page (see <kern/kinfo.h>). kinfo_bootstrap
+ * allocates it once the VM system and the clock device are up; after
+ * that cpu 0 refreshes it every hardclock. kinfo_clockpage returns
+ * its physical address, or 0 before kinfo_bootstrap.
+ */
+void kinfo_bootstrap(void);
+paddr_t kinfo_clockpage(void);
+
 /*
  * arithmetic on times
  *
@@ -50,6 +50,11 @@
  * returns the actual length of string found in GOT. DEST is always
  * null-terminated on success. LEN and GOT include the null terminator.
  *
+ * copyinptrs copies a null-terminated array of user pointers, such as
+ * an argv, from USERSRC into DEST, which holds up to MAX pointers, and
+ * returns the number of pointers before the null in COUNT. It returns
+ * E2BIG if there's no null among the first MAX.
+ *
  * All of these functions return 0 on success, EFAULT if a memory
  * addressing error was encountered, or (for the string versions)
  * ENAMETOOLONG if the space available was insufficient.
@@ -68,6 +73,8 @@ int copyin(const_userptr_t usersrc, void *dest, size_t len);
 int copyout(const void *src, userptr_t userdest, size_t len);
 int copyinstr(const_userptr_t usersrc, char *dest, size_t len, size_t *got);
 int copyoutstr(const char *src, userptr_t userdest, size_t len, size_t *got);
+int copyinptrs(const_userptr_t usersrc, userptr_t *dest, size_t max,
+	       size_t *count);
 
 
 #endif /* _COPYINOUT_H_ */
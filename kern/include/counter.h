@@ -0,0 +1,38 @@
+#ifndef _COUNTER_H_
+#define _COUNTER_H_
+
+/*
+ * Per-cpu event counters.
+ *
+ * A struct counter names a statistic; the counts themselves live in a
+ * slot of c_counters[] in each struct cpu, so bumping one only touches
+ * the local cpu's cache lines and needs no lock, just interrupts off
+ * for the moment it takes. counter_read adds up the slots of all cpus,
+ * which is slow but only done on demand.
+ *
+ * A counter takes a slot, and shows up in the dump, the first time it
+ * is bumped; after that it must never be freed. Counts bumped before
+ * the first cpu structure exists are dropped.
+ */
+
+#define COUNTER_SLOTS 32		/* slot 0 means "none yet" */
+#define COUNTER_NAMELEN 24
+
+struct counter {
+	char ctr_name[COUNTER_NAMELEN];
+	unsigned ctr_slot;		/* index in c_counters[], or 0 */
+	uint64_t ctr_base;		/* sum at last counter_reset */
+	struct counter *ctr_next;	/* next on the list for the dump */
+};
+
+#define COUNTER_INITIALIZER(name) { name, 0, 0, NULL }
+
+void counter_add(struct counter *ctr, unsigned n);
+#define counter_inc(ctr) counter_add(ctr, 1)
+uint64_t counter_read(struct counter *ctr);
+
+/* Kernel menu support. */
+void counter_print(void);
+void counter_reset(void);
+
+#endif /* _COUNTER_H_ */
@@ -33,9 +33,20 @@
 
 #include <spinlock.h>
 #include <threadlist.h>
+#include <lockstat.h>
+#include <counter.h>
+#include <syscall.h>
 #include <machine/vm.h>  /* for TLBSHOOTDOWN_MAX */
 
 
+/*
+ * Number of buckets in the per-cpu run queue latency histogram. Bucket
+ * N counts waits of 2^N to 2^(N+1)-1 microseconds (bucket 0 also takes
+ * waits under 1 microsecond); the last bucket takes everything longer.
+ */
+#define SCHEDLAT_BUCKETS 20
+
+
 /*
  * Per-cpu structure
  *
@@ -59,16 +70,30 @@ struct cpu {
 	 */
 	struct thread *c_curthread;	/* Current thread on cpu */
 	struct threadlist c_zombies;	/* List of exited threads */
+	struct threadlist c_threadcache; /* Dead threads kept for reuse */
 	unsigned c_hardclocks;		/* Counter of hardclock() calls */
 	unsigned c_spinlocks;		/* Counter of spinlocks held */
 
+	/*
+	 * Written only by this cpu; read by others without locking.
+	 */
+	volatile unsigned c_rcu_seen;	/* RCU gen at last quiescent point */
+	volatile unsigned c_counters_seq; /* Odd while c_counters changes */
+	uint64_t c_counters[COUNTER_SLOTS]; /* Per-cpu event counts */
+	unsigned c_syscallstat_gen;	/* Reset generation of c_syscallstat */
+	struct syscallstat c_syscallstat[SYSCALL_NSTATS];
+
 	/*
 	 * Accessed by other cpus.
 	 * Protected by the runqueue lock.
 	 */
 	bool c_isidle;			/* True if this cpu is idle */
+	unsigned c_pass;		/* Pass of last dispatched thread */
 	struct threadlist c_runqueue;	/* Run queue for this cpu */
 	struct spinlock c_runqueue_lock;
+	struct lockstat c_runqueue_stat; /* Contention stats for the lock */
+	unsigned c_schedlat[SCHEDLAT_BUCKETS]; /* Run queue latency counts */
+	unsigned c_schedlat_max;	/* Longest run queue wait (usec) */
 
 	/*
 	 * Accessed by other cpus.
@@ -112,6 +137,25 @@ void cpu_hatch(unsigned software_number);
  */
 void cpu_identify(char *buf, size_t max);
 
+/*
+ * Return the oldest RCU generation recorded by any cpu at its last
+ * quiescent point. Every generation up to this one has ended its
+ * grace period. (See rcu.h.)
+ */
+unsigned cpu_rcu_seen(void);
+
+/*
+ * Return the total over all cpus of c_counters[SLOT]. (See counter.h.)
+ */
+uint64_t cpu_counter_sum(unsigned slot);
+
+/*
+ * Add up c_syscallstat[SLOT] over all cpus into RET, skipping cpus
+ * whose stats predate reset generation GEN. (See syscall.c.)
+ */
+void cpu_syscallstat_sum(unsigned slot, unsigned gen,
+			 struct syscallstat *ret);
+
 /*
  * Hardware-level interrupt on/off, for the current CPU.
  *
@@ -0,0 +1,18 @@
+#ifndef _KERN_FUTEX_H_
+#define _KERN_FUTEX_H_
+
+/*
+ * Operations for the futex() system call.
+ *
+ * FUTEX_WAIT  Sleep until woken, but only if the int at UADDR still
+ *             holds VAL; otherwise fail right away with EAGAIN.
+ * FUTEX_WAKE  Wake up to VAL threads sleeping on UADDR. Returns the
+ *             number actually woken.
+ *
+ * Waiters are matched by physical address, so two processes sharing
+ * a page may synchronize through it regardless of where it's mapped.
+ */
+#define FUTEX_WAIT   0
+#define FUTEX_WAKE   1
+
+#endif /* _KERN_FUTEX_H_ */
@@ -0,0 +1,32 @@
+#ifndef _KERN_KINFO_H_
+#define _KERN_KINFO_H_
+
+/*
+ * Kernel info pages: read-only pages the kernel maps into every user
+ * address space, so that getpid() and time() can be answered without
+ * a system call. Writing to either page is a fatal fault.
+ *
+ * KINFO_PROC   This process's struct kinfo_proc. Set up at fork and
+ *              exec; it never changes after that.
+ * KINFO_CLOCK  The struct kinfo_clock shared by all processes, updated
+ *              every hardclock. kc_seq is odd while an update is in
+ *              progress; read it, then the time, then kc_seq again,
+ *              and retry if it was odd or changed.
+ *
+ * Both sit just below the user stack.
+ */
+#define KINFO_PROC   0x7ffe0000
+#define KINFO_CLOCK  0x7ffe1000
+
+struct kinfo_proc {
+	__pid_t kp_pid;
+	__pid_t kp_ppid;
+};
+
+struct kinfo_clock {
+	volatile __u32 kc_seq;
+	volatile __u32 kc_nsec;
+	volatile __time_t kc_sec;
+};
+
+#endif /* _KERN_KINFO_H_ */
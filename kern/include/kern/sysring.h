@@ -0,0 +1,48 @@
+#ifndef _KERN_SYSRING_H_
+#define _KERN_SYSRING_H_
+
+/*
+ * Batched system calls through a submission/completion ring pair in
+ * user memory.
+ *
+ * Userland fills in submission entries at sr_sqtail and advances it.
+ * sysring_enter(ring, n) runs up to n of them in order, starting at
+ * sr_sqhead. It posts a completion for each at sr_cqtail, advances
+ * sr_sqhead and sr_cqtail, and returns how many it ran. Userland
+ * takes completions from sr_cqhead and advances that; since the ring
+ * is in its own memory, it can poll for completions without a system
+ * call. Indexes run freely and are reduced mod sr_entries, which must
+ * be a power of 2 no bigger than SYSRING_MAXENTRIES. The kernel stops
+ * early if the completion ring fills up.
+ *
+ * Each submission is one system call: a call number and up to four
+ * register arguments, just as for the trap. Calls that don't return
+ * to their caller (fork, execv, _exit, and sysring_enter itself) fail
+ * with ENOSYS. Calls run synchronously, so each one sysring_enter
+ * counts has its completion posted by the time it returns.
+ */
+#define SYSRING_MAXENTRIES 256
+
+struct sysring_sqe {
+	__i32 sqe_callno;
+	__i32 sqe_args[4];
+	__u32 sqe_data;		/* handed back in the completion */
+};
+
+struct sysring_cqe {
+	__u32 cqe_data;
+	__i32 cqe_result;	/* return value, or -1 */
+	__i32 cqe_errno;	/* error code, or 0 */
+};
+
+struct sysring {
+	volatile __u32 sr_sqhead;	/* advanced by the kernel */
+	volatile __u32 sr_sqtail;	/* advanced by userland */
+	volatile __u32 sr_cqhead;	/* advanced by userland */
+	volatile __u32 sr_cqtail;	/* advanced by the kernel */
+	__u32 sr_entries;		/* size of both rings */
+	struct sysring_sqe *sr_sqes;
+	struct sysring_cqe *sr_cqes;
+};
+
+#endif /* _KERN_SYSRING_H_ */
@@ -0,0 +1,61 @@
+#ifndef _LOCKSTAT_H_
+#define _LOCKSTAT_H_
+
+/*
+ * Lock contention statistics.
+ *
+ * A lock that should be watched points at a struct lockstat (see
+ * spinlock_setstat, lock_setstat, rwlock_setstat). While collection is
+ * turned on from the kernel menu, each acquisition of such a lock
+ * records whether it had to wait, how many times it polled the lock
+ * word before getting it, and how long it was held. Locks without a
+ * lockstat, or any lock while collection is off, pay one test.
+ *
+ * The counters are only updated by whoever holds the lock (or, for
+ * rwlocks, under the rwlock's internal spinlock), so they need no
+ * locking of their own. A lockstat shows up in the dump once it has
+ * been acquired with collection on; after that it must never be freed.
+ */
+
+#include <kern/time.h>
+
+#define LOCKSTAT_NAMELEN 24
+
+struct lockstat {
+	char ls_name[LOCKSTAT_NAMELEN];
+	unsigned ls_acquires;		/* times acquired */
+	unsigned ls_contended;		/* times the lock was busy */
+	uint64_t ls_spins;		/* total polls of a busy lock */
+	unsigned ls_holds;		/* exclusive holds timed */
+	uint64_t ls_holdns;		/* total exclusive hold time, ns */
+	uint32_t ls_maxholdns;		/* longest exclusive hold, ns */
+	bool ls_timing;			/* current hold is being timed */
+	struct timespec ls_acqtime;	/* when the current hold began */
+	bool ls_listed;			/* on the list for the dump */
+	struct lockstat *ls_next;	/* next on that list */
+};
+
+#define LOCKSTAT_INITIALIZER(name) \
+	{ name, 0, 0, 0, 0, 0, 0, false, { 0, 0 }, false, NULL }
+
+void lockstat_init(struct lockstat *ls, const char *name);
+
+/*
+ * Hooks for the lock implementations.
+ *
+ * acquired	 Exclusive hold began; CONTENDED if the lock was busy, with
+ *		 SPINS unsuccessful polls. Starts timing the hold.
+ * acquired_shared
+ *		 Same, for a shared (reader) hold, which is not timed.
+ * released	 Exclusive hold ended.
+ */
+void lockstat_acquired(struct lockstat *ls, bool contended, unsigned spins);
+void lockstat_acquired_shared(struct lockstat *ls, bool contended);
+void lockstat_released(struct lockstat *ls);
+
+/* Kernel menu support. */
+void lockstat_enable(bool on);
+void lockstat_print(void);
+void lockstat_reset(void);
+
+#endif /* _LOCKSTAT_H_ */
@@ -38,8 +38,12 @@
 
 #include <spinlock.h>
 #include <synch.h>
+#include <rcu.h>
+#include <thread.h>
 #include <types.h>
 #include <kern/errno.h>
+#include <kern/time.h>
+#include <kern/resource.h>
 
 struct addrspace;
 struct thread;
@@ -47,20 +51,27 @@ struct vnode;
 
 /* structure for maintaining exit status information */
 struct exit_status {
-  struct semaphore *exit_sem; // used to wait/signal for waitpid usage
   int exitcode;
 };
 /* structures for communicating exit status needs between parent/child */
 struct exit_status_needed {
   int needed;
+  int exited; // child is a zombie waiting for its parent
   struct spinlock esn_lock;
 };
 
-struct esn_mailbox {
-  pid_t child_pid;
-  struct exit_status_needed *child_esn;
-  struct esn_mailbox *next_mailbox;
-};
+/*
+ * Proportional-share (stride) scheduling. Each process holds tickets
+ * according to its priority, a Unix-style nice value from PRIO_MIN to
+ * PRIO_MAX where lower gets more cpu. Its threads' pass values advance
+ * by the process's stride for every hardclock they run, and
+ * thread_switch always picks the ready thread with the lowest pass.
+ * At the default priority every process has the same stride, which
+ * amounts to plain round-robin.
+ */
+#define STRIDE_ONE          (1U << 20)
+#define PRIO_TICKETS(prio)  ((PRIO_MAX + 1 - (prio)) * 10)
+#define PRIO_STRIDE(prio)   (STRIDE_ONE / PRIO_TICKETS(prio))
 
 /*
  * Process structure.
@@ -93,32 +104,78 @@ struct proc {
   /* Exit Status */
   struct exit_status p_exit_status;
   struct exit_status_needed p_es_needed;
-  struct esn_mailbox *child_esn_mailbox;
 
   /* PID/PPID */
   pid_t pid, ppid;
+
+  /* Scheduling (p_stride may be read without p_lock) */
+  int p_priority;     /* nice value, PRIO_MIN..PRIO_MAX */
+  unsigned p_stride;  /* PRIO_STRIDE(p_priority) */
+
+  /* Resource usage (protected by p_lock) */
+  struct threadusage p_usage;   /* totals from threads that have detached */
+  struct threadusage p_cusage;  /* totals from children that were reaped */
+
+  /* Deferred free; lookups may still be looking at us (see pid_table) */
+  struct rcu_head p_rcu;
+
+  /* Link on the reap queue once we're an orphaned zombie */
+  struct proc *p_reapnext;
+
+  /*
+   * Children and waitpid support. Forked children we haven't reaped
+   * are on p_children; an exiting child whose parent still wants its
+   * status also appends itself to the parent's p_zombies and wakes
+   * p_childwait. All of these, including the links in the child, are
+   * protected by the parent's p_lock. The prev pointers let a child
+   * be unlinked in O(1).
+   */
+  struct proc *p_parent;       /* valid while p_es_needed.needed */
+  struct wchan *p_childwait;   /* waitpid sleeps here, on p_lock */
+  struct proc *p_children;     /* unreaped children */
+  struct proc *p_sibnext;      /* link on our parent's p_children */
+  struct proc **p_sibprev;     /* NULL once reaped */
+  struct proc *p_zombies;      /* exited children, oldest first */
+  struct proc **p_zombietail;
+  struct proc *p_zombienext;   /* link on our parent's p_zombies */
+  struct proc **p_zombieprev;  /* NULL unless on p_zombies */
 };
-/* Structures for maintaining list of pids.
- * I believe this is a better solution than using a hash table, given the relatively
- * small amount of memory SYS161 provides. If many processes are running, then there 
- * probably won't be many processes created in quick succession (otherwise we'd run out of memory), 
- * and if many processes have quit, the next new processes should be quickly assigned to a low-numbered
- * pid.
+/*
+ * Process table: a directly indexed pid -> proc map.
+ *
+ * A pid lives in slot pid % PID_SLOTS. Free slots are kept in a FIFO
+ * queue, so allocation and removal are O(1), and so is lookup. Each
+ * time a slot is reused its pid goes up by PID_SLOTS (wrapping within
+ * __PID_MIN..__PID_MAX). Because the queue is FIFO, a freed slot isn't
+ * reused until every slot freed before it has been, so a pid is not
+ * recycled right after its process goes away unless the table is
+ * nearly full. The kernel process always has pid __PID_MIN-1.
+ *
+ * PID_SLOTS caps the number of processes. It's well past what fits in
+ * memory under dumbvm; raise it (up to __PID_MAX+1) if that changes.
+ *
+ * Lookups read pt_procs under rcu_read_lock() without taking pt_lock,
+ * which only serializes new_pid/remove_pid. Procs are freed via
+ * call_rcu once no lookup can still be looking at them.
+ *
+ * pt_lock must stay a spinlock (or something else that works without
+ * a current thread): the kernel process gets its pid from
+ * proc_bootstrap, before thread_bootstrap, and a sleep lock can't be
+ * taken there.
  */
-struct pid_list {
-  int size;
-  struct pid_list_node *knode; // node for kernel process
-  struct spinlock pl_lock;
-};
-
-struct pid_list_node {
-  pid_t pid;
-  struct proc *proc;
-  struct pid_list_node *next;
+#define PID_SLOTS        1024 /* power of two, at most __PID_MAX+1 */
+
+struct pid_table {
+  int size;                        // live pids
+  struct proc *pt_procs[PID_SLOTS]; // by slot; NULL if free
+  pid_t pt_pids[PID_SLOTS];        // last pid given out from each slot
+  unsigned pt_free[PID_SLOTS];     // circular FIFO of free slots
+  unsigned pt_freehead, pt_nfree;
+  struct spinlock pt_lock;         // held to add/remove; lookups are lock-free
 };
 
-/* List for tracking pids */
-extern struct pid_list* pid_list;
+/* Table for tracking pids */
+extern struct pid_table *pid_table;
 
 /* This is the process structure for the kernel and for kernel-only threads. */
 extern struct proc *kproc;
@@ -149,20 +206,35 @@ struct addrspace *proc_setas(struct addrspace *);
 struct addrspace *proc_setas_other(struct proc *proc, struct addrspace *newas);
 
 
-// PID LIST HELPER FUNCTIONS //
+// PID TABLE HELPER FUNCTIONS //
 
 /* Called from proc_bootstrap(), before kernel proc initialized */
-int pid_list_init(void);
+int pid_table_init(void);
 
-/* Add a new pid to list of all pids */
+/* Allocate a pid for proc and enter it in the table */
 int new_pid(struct proc *proc);
 
-/* Remove a pid from the list of all pids, returns 0 if successful*/
+/* Remove a pid from the table, returns 0 if successful*/
 int remove_pid(pid_t p);
 
-/* Helper for waitpid(). */
-int get_exit_code(pid_t pid, userptr_t status, struct proc **proc);
+/* Look up a pid; call inside rcu_read_lock() */
+struct proc *pid_table_find(pid_t pid);
+
+/* Helpers for fork()/waitpid()/_exit(); call with parent->p_lock held. */
+void proc_add_child(struct proc *parent, struct proc *child);
+void proc_remove_child(struct proc *parent, struct proc *child);
+void proc_add_zombie(struct proc *parent, struct proc *child);
+struct proc *proc_take_zombie(struct proc *parent, struct proc *child);
 
-/* Cleans zombie processes */
+/* Helpers for getpriority()/setpriority(). */
+int proc_getpriority(pid_t pid, int *prio);
+int proc_setpriority(pid_t pid, int prio);
+
+/*
+ * Orphaned zombies (children that had exited when their parent did)
+ * are put on a reap queue by the parent's sys__exit, and proc_exorcise
+ * destroys a few of them at a time (it's called on each proc_create).
+ */
+void proc_orphan_zombie(struct proc *proc);
 void proc_exorcise(void);
 #endif /* _PROC_H_ */
@@ -0,0 +1,47 @@
+#ifndef _RCU_H_
+#define _RCU_H_
+
+/*
+ * Read-copy-update.
+ *
+ * Readers traverse an RCU-protected structure between rcu_read_lock
+ * and rcu_read_unlock without taking any lock; they must not sleep in
+ * between. Writers still exclude each other with an ordinary lock,
+ * publish new nodes with rcu_assign (which orders the node's contents
+ * before the pointer to it), and unlink old ones with a single store.
+ * An unlinked node may still be in use by readers, so instead of
+ * being freed it is handed to call_rcu, which calls FUNC(DATA) once
+ * every cpu has passed a quiescent point (a context switch, going
+ * idle, or running in user mode) since the unlink.
+ *
+ * A read section runs with interrupts off, so a cpu can't pass a
+ * quiescent point while one is in progress.
+ *
+ * Callbacks run in thread context, from a later call_rcu (or
+ * rcu_reclaim) once their grace period has elapsed, so they may do
+ * anything that can be done in the calling thread, short of taking
+ * locks the caller holds.
+ */
+
+#include <membar.h>
+
+struct rcu_head {
+	struct rcu_head *rh_next;
+	void (*rh_func)(void *);
+	void *rh_data;			/* argument for rh_func */
+	unsigned rh_gen;		/* generation at call_rcu time */
+};
+
+void rcu_read_lock(void);
+void rcu_read_unlock(void);
+
+#define rcu_assign(p, v)	(membar_store_store(), (p) = (v))
+#define rcu_deref(p)		(*(__typeof__(p) volatile *)&(p))
+
+void call_rcu(struct rcu_head *rh, void (*func)(void *), void *data);
+void rcu_reclaim(void);
+
+/* Called by the scheduler at quiescent points. */
+void rcu_quiescent(void);
+
+#endif /* _RCU_H_ */
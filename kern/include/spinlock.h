@@ -45,6 +45,8 @@
 /* Get the machine-dependent bits. */
 #include <machine/spinlock.h>
 
+struct lockstat; /* in lockstat.h */
+
 /*
  * Basic spinlock.
  *
@@ -57,26 +59,46 @@
 struct spinlock {
 	volatile spinlock_data_t splk_lock; /* Memory word where we spin. */
 	struct cpu *splk_holder;	    /* CPU holding this lock. */
+	struct lockstat *splk_stat;	    /* Contention stats, or NULL. */
+	volatile spinlock_data_t splk_next;    /* Ticket: next to hand out. */
+	volatile spinlock_data_t splk_serving; /* Ticket: now serving. */
+	bool splk_ticket;		    /* Use tickets, not splk_lock. */
 };
 
 /*
  * Initializer for cases where a spinlock needs to be static or global.
  */
-#define SPINLOCK_INITIALIZER	{ SPINLOCK_DATA_INITIALIZER, NULL }
+#define SPINLOCK_INITIALIZER \
+	{ SPINLOCK_DATA_INITIALIZER, NULL, NULL, 0, 0, false }
+#define SPINLOCK_INITIALIZER_STAT(ls) \
+	{ SPINLOCK_DATA_INITIALIZER, NULL, (ls), 0, 0, false }
+#define SPINLOCK_INITIALIZER_TICKET(ls) \
+	{ SPINLOCK_DATA_INITIALIZER, NULL, (ls), 0, 0, true }
 
 /*
  * Spinlock functions.
  *
  * init		Initialize the contents of a spinlock.
+ * init_ticket	Same, but make it a ticket lock (see below).
  * cleanup	Opposite of init. Lock must be unlocked.
  *
  * acquire	Get the lock, spinning as necessary. Also disables interrupts.
  * release	Release the lock. May re-enable interrupts.
  *
  * do_i_hold	Check if the current CPU holds the lock.
+ *
+ * setstat	Start keeping contention statistics for the lock in LS.
+ *
+ * An ordinary spinlock is test-and-test-and-set: whichever cpu happens
+ * to win the race when the lock comes free gets it, and all the waiters
+ * hammer the same word. A ticket lock instead hands out numbers as cpus
+ * arrive and grants the lock in that order, so a waiter can't be passed
+ * over indefinitely. It costs an extra atomic op per acquire, so use it
+ * for hot global locks where fairness under contention matters.
  */
 
 void spinlock_init(struct spinlock *lk);
+void spinlock_init_ticket(struct spinlock *lk);
 void spinlock_cleanup(struct spinlock *lk);
 
 void spinlock_acquire(struct spinlock *lk);
@@ -84,5 +106,7 @@ void spinlock_release(struct spinlock *lk);
 
 bool spinlock_do_i_hold(struct spinlock *lk);
 
+void spinlock_setstat(struct spinlock *lk, struct lockstat *ls);
+
 
 #endif /* _SPINLOCK_H_ */
@@ -37,6 +37,8 @@
 
 #include <spinlock.h>
 
+struct lockstat; /* in lockstat.h */
+
 /*
  * Dijkstra-style semaphore.
  *
@@ -58,9 +60,19 @@ void sem_destroy(struct semaphore *);
  *     P (proberen): decrement count. If the count is 0, block until
  *                   the count is 1 again before decrementing.
  *     V (verhogen): increment count.
+ *
+ *     P_timeout:    like P, but give up and return ETIMEDOUT if the
+ *                   count hasn't become nonzero within MS
+ *                   milliseconds. With MS 0, never blocks. Returns 0
+ *                   on success. The wait is ended by a timeout (see
+ *                   clock.h), not by polling.
+ *     V_n:          increment count by N, waking up to N waiters with
+ *                   one acquisition of the semaphore's spinlock.
  */
 void P(struct semaphore *);
 void V(struct semaphore *);
+int P_timeout(struct semaphore *, unsigned ms);
+void V_n(struct semaphore *, unsigned n);
 
 
 /*
@@ -74,8 +86,14 @@ void V(struct semaphore *);
  */
 struct lock {
         char *lk_name;
-        // add what you need here
-        // (don't forget to mark things volatile as needed)
+	volatile spinlock_data_t lk_locked;	/* lock word; 1 if held */
+	struct thread *volatile lk_holder;	/* thread holding the lock */
+	volatile unsigned lk_waiters;	/* threads in the sleep path */
+	struct wchan *lk_wchan;		/* where waiters sleep */
+	struct spinlock lk_spinlock;	/* protects lk_wchan */
+	struct lockstat *lk_stat;	/* contention stats, or NULL */
+	unsigned lk_donation;		/* best stride lent by waiters, or 0 */
+	struct lock *lk_nextheld;	/* next in holder's t_heldlocks */
 };
 
 struct lock *lock_create(const char *name);
@@ -89,12 +107,26 @@ void lock_destroy(struct lock *);
  *                   this.
  *    lock_do_i_hold - Return true if the current thread holds the lock;
  *                   false otherwise.
+ *    lock_setstat   - Start keeping contention statistics in LS.
+ *
+ * These operations must be atomic.
  *
- * These operations must be atomic. You get to write them.
+ * Taking a free lock, or releasing one nobody is waiting for, is a
+ * single atomic operation on lk_locked and doesn't touch the wchan
+ * spinlock. A thread that finds the lock held spins for a while as
+ * long as the holder is running on another cpu, on the theory that it
+ * will let go soon; otherwise it goes to sleep.
+ *
+ * A thread that sleeps on a lock lends its priority to the holder, and
+ * through it down any chain of holders that are themselves asleep on
+ * locks, so that a low-priority holder can't keep high-priority
+ * waiters out indefinitely. The loan is taken back when the lock is
+ * released.
  */
 void lock_acquire(struct lock *);
 void lock_release(struct lock *);
 bool lock_do_i_hold(struct lock *);
+void lock_setstat(struct lock *, struct lockstat *ls);
 
 
 /*
@@ -113,8 +145,8 @@ bool lock_do_i_hold(struct lock *);
 
 struct cv {
         char *cv_name;
-        // add what you need here
-        // (don't forget to mark things volatile as needed)
+	struct wchan *cv_wchan;		/* where waiters sleep */
+	struct spinlock cv_spinlock;	/* protects cv_wchan */
 };
 
 struct cv *cv_create(const char *name);
@@ -131,11 +163,62 @@ void cv_destroy(struct cv *);
  * in. Note that under normal circumstances the same lock should be used
  * on all operations with any particular CV.
  *
- * These operations must be atomic. You get to write them.
+ * These operations must be atomic.
+ *
+ * cv_signal and cv_broadcast don't actually wake anyone: since the
+ * caller holds the lock, the waiters couldn't proceed anyway. Instead
+ * they are moved straight from the CV's wait channel onto the lock's,
+ * and lock_release wakes them one at a time as the lock frees up.
  */
 void cv_wait(struct cv *cv, struct lock *lock);
 void cv_signal(struct cv *cv, struct lock *lock);
 void cv_broadcast(struct cv *cv, struct lock *lock);
 
 
+/*
+ * Reader-writer lock.
+ *
+ * Any number of readers may hold the lock at once, or one writer.
+ * Writers are preferred: once a writer is waiting, new readers wait
+ * behind it, so a steady stream of readers can't starve writers out.
+ * Like locks, rwlocks are not recursive; a thread holding the lock
+ * for reading must not try to take it again, as a writer may have
+ * queued up in between.
+ *
+ * Uncontended acquires and releases never sleep or touch curthread,
+ * so rwlocks are safe to use during early boot.
+ *
+ * The name field is for easier debugging. A copy of the name is made
+ * internally.
+ */
+struct rwlock {
+	char *rwlk_name;
+	struct spinlock rwlk_spinlock;	/* protects everything below */
+	struct wchan *rwlk_rwchan;	/* where readers wait */
+	struct wchan *rwlk_wwchan;	/* where writers wait */
+	unsigned rwlk_readers;		/* number of readers holding it */
+	unsigned rwlk_wwaiters;		/* number of writers waiting */
+	bool rwlk_writer;		/* true if a writer holds it */
+	struct lockstat *rwlk_stat;	/* contention stats, or NULL */
+};
+
+struct rwlock *rwlock_create(const char *name);
+void rwlock_destroy(struct rwlock *);
+
+/*
+ * Operations:
+ *    rwlock_acquire_read  - Get the lock for reading (shared).
+ *    rwlock_release_read  - Give up a read hold.
+ *    rwlock_acquire_write - Get the lock for writing (exclusive).
+ *    rwlock_release_write - Give up the write hold.
+ *    rwlock_setstat       - Start keeping contention statistics in LS.
+ *                           Only write holds are timed.
+ */
+void rwlock_acquire_read(struct rwlock *);
+void rwlock_release_read(struct rwlock *);
+void rwlock_acquire_write(struct rwlock *);
+void rwlock_release_write(struct rwlock *);
+void rwlock_setstat(struct rwlock *, struct lockstat *ls);
+
+
 #endif /* _SYNCH_H_ */
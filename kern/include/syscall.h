@@ -40,6 +40,40 @@ struct trapframe; /* from <machine/trapframe.h> */
 
 void syscall(struct trapframe *tf);
 
+/*
+ * Run one system call given its number and register arguments, for
+ * sysring_enter. Returns ENOSYS for calls that can't be batched.
+ */
+int syscall_batch(int callno, const int32_t *args, int32_t *retval);
+
+/*
+ * Per-syscall statistics. Each cpu keeps a struct syscallstat for
+ * every call in the dispatch table (see syscall.c), and the menu adds
+ * them up. ss_usec and ss_hist only cover calls made while timing was
+ * on; histogram bucket N counts calls that took 2^N to 2^(N+1)-1
+ * microseconds (bucket 0 also takes calls under 1 microsecond), and
+ * the last bucket takes everything longer.
+ *
+ * syscall_bootstrap sets up the dispatch table; call it once during
+ * boot. syscall_timing_enable turns timing on or off; it reads the
+ * clock twice per call, so it's off by default. syscall_stats_print
+ * dumps the totals and syscall_stats_reset clears them.
+ */
+#define SYSCALL_NSTATS       24
+#define SYSCALL_HISTBUCKETS  16
+
+struct syscallstat {
+	uint32_t ss_calls;
+	uint32_t ss_errors;
+	uint64_t ss_usec;			/* total time of timed calls */
+	uint32_t ss_hist[SYSCALL_HISTBUCKETS];	/* timed calls by duration */
+};
+
+void syscall_bootstrap(void);
+void syscall_timing_enable(bool on);
+void syscall_stats_print(void);
+void syscall_stats_reset(void);
+
 /*
  * Support functions.
  */
@@ -47,6 +81,9 @@ void syscall(struct trapframe *tf);
 /* Helper for fork(). You write this. */
 void enter_forked_process(void *tf, unsigned long data2);
 
+/* Set up the futex wait table. Called once during boot. */
+void futex_bootstrap(void);
+
 /* Enter user mode. Does not return. */
 __DEAD void enter_new_process(int argc, userptr_t argv, userptr_t env,
 		       vaddr_t stackptr, vaddr_t entrypoint);
@@ -59,9 +96,14 @@ int sys_fork(struct trapframe *tf, pid_t *retpid);
 int sys_execv(char *progname, char **argv);
 int sys_waitpid(pid_t pid, userptr_t status, int options, pid_t *retpid); 
 void sys__exit(int exitcode);
+int sys_getrusage(int who, userptr_t usage);
+int sys_getpriority(int which, pid_t who, int32_t *retval);
+int sys_setpriority(int which, pid_t who, int prio);
+int sys_futex(userptr_t uaddr, int op, int val, int32_t *retval);
+int sys_sysring_enter(userptr_t ring, unsigned to_submit, int32_t *retval);
 int sys_reboot(int code);
 int sys___time(userptr_t user_seconds, userptr_t user_nanoseconds);
 
-int sys_printchar(const char *arg);
+int sys_printchar(const_userptr_t arg);
 
 #endif /* _SYSCALL_H_ */
@@ -78,6 +78,9 @@ int semu19(int, char **);
 int semu20(int, char **);
 int semu21(int, char **);
 int semu22(int, char **);
+int semu23(int, char **);
+int semu24(int, char **);
+int semu25(int, char **);
 
 /* filesystem tests */
 int fstest(int, char **);
@@ -94,6 +97,7 @@ int kmallocstress(int, char **);
 int kmalloctest3(int, char **);
 int kmalloctest4(int, char **);
 int nettest(int, char **);
+int pidtest(int, char **);
 
 /* Routine for running a user-level program. */
 int runprogram(char *progname, int num_args, char **argv);
@@ -39,8 +39,10 @@
 #include <array.h>
 #include <spinlock.h>
 #include <threadlist.h>
+#include <kern/time.h>
 
 struct cpu;
+struct lock;
 
 /* get machine-dependent defs */
 #include <machine/thread.h>
@@ -64,6 +66,20 @@ typedef enum {
 	S_ZOMBIE,	/* zombie; exited but not yet deleted */
 } threadstate_t;
 
+/*
+ * Resource usage counters, for getrusage(). These are only updated on
+ * the cpu the thread is running on (by the thread itself or by an
+ * interrupt taken while it runs), so they need no locking. Times are
+ * counted in hardclocks.
+ */
+struct threadusage {
+	unsigned tu_uticks;		/* hardclocks spent in user mode */
+	unsigned tu_sticks;		/* hardclocks spent in the kernel */
+	unsigned tu_nvcsw;		/* voluntary context switches */
+	unsigned tu_nivcsw;		/* involuntary context switches */
+	unsigned tu_nfaults;		/* VM faults taken */
+};
+
 /* Thread structure. */
 struct thread {
 	/*
@@ -83,6 +99,12 @@ struct thread {
 	struct switchframe *t_context;	/* Saved register context (on stack) */
 	struct cpu *t_cpu;		/* CPU thread runs on */
 	struct proc *t_proc;		/* Process thread belongs to */
+	unsigned t_slicestart;		/* c_hardclocks when last dispatched */
+	unsigned t_pass;		/* Stride scheduling virtual time */
+	unsigned t_inherit;		/* Stride lent by lock waiters, or 0 */
+	struct lock *t_blockedon;	/* Lock we are asleep waiting for */
+	struct lock *t_heldlocks;	/* Locks we hold, via lk_nextheld */
+	struct timespec t_readytime;	/* When made runnable (latency trace) */
 
 	/*
 	 * Interrupt state fields.
@@ -98,9 +120,13 @@ struct thread {
 	 * rather than per-cpu or global?
 	 */
 	bool t_in_interrupt;		/* Are we in an interrupt? */
+	bool t_intr_user;		/* Did it interrupt user mode? */
 	int t_curspl;			/* Current spl*() state */
 	int t_iplhigh_count;		/* # of times IPL has been raised */
 
+	/* Resource usage */
+	struct threadusage t_usage;
+
 	/*
 	 * Public fields
 	 */
@@ -157,6 +183,38 @@ __DEAD void thread_exit(void);
  */
 void thread_yield(void);
 
+/*
+ * Add the usage counts in FROM to TO.
+ */
+void threadusage_add(struct threadusage *to, const struct threadusage *from);
+
+/*
+ * Return the stride T is charged per hardclock: its process's stride,
+ * or the stride it has inherited from waiters on locks it holds (see
+ * synch.c), whichever is smaller (that is, whichever is the higher
+ * priority).
+ */
+unsigned thread_stride(struct thread *t);
+
+/*
+ * Let T, which has just been given a higher priority, run soon if it
+ * is waiting on a run queue.
+ */
+void thread_boost(struct thread *t);
+
+/*
+ * Run queue latency tracing. When on, the time from a thread being
+ * made runnable to it being dispatched is recorded in a per-cpu
+ * histogram (see struct cpu).
+ *
+ * thread_schedlat_enable turns tracing on or off.
+ * thread_schedlat_print prints the histograms.
+ * thread_schedlat_reset clears them.
+ */
+void thread_schedlat_enable(bool on);
+void thread_schedlat_print(void);
+void thread_schedlat_reset(void);
+
 /*
  * Reshuffle the run queue. Called from the timer interrupt.
  */
@@ -36,6 +36,7 @@
 
 
 struct spinlock; /* in spinlock.h */
+struct thread; /* in thread.h */
 struct wchan; /* Opaque */
 
 /*
@@ -76,5 +77,27 @@ void wchan_sleep(struct wchan *wc, struct spinlock *lk);
 void wchan_wakeone(struct wchan *wc, struct spinlock *lk);
 void wchan_wakeall(struct wchan *wc, struct spinlock *lk);
 
+/*
+ * Wake up to N threads sleeping on a wait channel, in one pass.
+ * Returns the number woken. The associated spinlock should be locked.
+ */
+unsigned wchan_waken(struct wchan *wc, unsigned n, struct spinlock *lk);
+
+/*
+ * Wake up thread T if, and only if, it is sleeping on the wait
+ * channel. Returns true if it was. The associated spinlock should be
+ * locked.
+ */
+bool wchan_wakethread(struct wchan *wc, struct spinlock *lk,
+		      struct thread *t);
+
+/*
+ * Move one thread, or all threads, sleeping on FROM over to TO without
+ * waking them. Both associated spinlocks should be locked. Returns the
+ * number of threads moved.
+ */
+unsigned wchan_requeue(struct wchan *from, struct spinlock *fromlk,
+		       struct wchan *to, struct spinlock *tolk, bool all);
+
 
 #endif /* _WCHAN_H_ */
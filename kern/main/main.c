@@ -43,6 +43,7 @@
 #include <current.h>
 #include <synch.h>
 #include <vm.h>
+#include <addrspace.h>
 #include <mainbus.h>
 #include <vfs.h>
 #include <device.h>
@@ -110,6 +111,8 @@ boot(void)
 	proc_bootstrap();
 	thread_bootstrap();
 	hardclock_bootstrap();
+	futex_bootstrap();
+	syscall_bootstrap();
 	vfs_bootstrap();
 	kheap_nextgeneration();
 
@@ -125,6 +128,8 @@ boot(void)
 
 	/* Late phase of initialization. */
 	vm_bootstrap();
+	kinfo_bootstrap();
+	execcache_bootstrap();
 	kprintf_bootstrap();
 	thread_start_cpus();
 
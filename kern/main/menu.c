@@ -37,6 +37,8 @@
 #include <clock.h>
 #include <thread.h>
 #include <proc.h>
+#include <lockstat.h>
+#include <counter.h>
 #include <vfs.h>
 #include <sfs.h>
 #include <syscall.h>
@@ -399,6 +401,92 @@ cmd_kheapdump(int nargs, char **args)
 	return 0;
 }
 
+static
+int
+cmd_schedlat(int nargs, char **args)
+{
+	if (nargs == 1) {
+		thread_schedlat_print();
+	}
+	else if (nargs == 2 && !strcmp(args[1], "on")) {
+		thread_schedlat_enable(true);
+	}
+	else if (nargs == 2 && !strcmp(args[1], "off")) {
+		thread_schedlat_enable(false);
+	}
+	else if (nargs == 2 && !strcmp(args[1], "reset")) {
+		thread_schedlat_reset();
+	}
+	else {
+		kprintf("Usage: sl [on|off|reset]\n");
+	}
+
+	return 0;
+}
+
+static
+int
+cmd_lockstat(int nargs, char **args)
+{
+	if (nargs == 1) {
+		lockstat_print();
+	}
+	else if (nargs == 2 && !strcmp(args[1], "on")) {
+		lockstat_enable(true);
+	}
+	else if (nargs == 2 && !strcmp(args[1], "off")) {
+		lockstat_enable(false);
+	}
+	else if (nargs == 2 && !strcmp(args[1], "reset")) {
+		lockstat_reset();
+	}
+	else {
+		kprintf("Usage: lks [on|off|reset]\n");
+	}
+
+	return 0;
+}
+
+static
+int
+cmd_counters(int nargs, char **args)
+{
+	if (nargs == 1) {
+		counter_print();
+	}
+	else if (nargs == 2 && !strcmp(args[1], "reset")) {
+		counter_reset();
+	}
+	else {
+		kprintf("Usage: cnt [reset]\n");
+	}
+
+	return 0;
+}
+
+static
+int
+cmd_syscalls(int nargs, char **args)
+{
+	if (nargs == 1) {
+		syscall_stats_print();
+	}
+	else if (nargs == 2 && !strcmp(args[1], "on")) {
+		syscall_timing_enable(true);
+	}
+	else if (nargs == 2 && !strcmp(args[1], "off")) {
+		syscall_timing_enable(false);
+	}
+	else if (nargs == 2 && !strcmp(args[1], "reset")) {
+		syscall_stats_reset();
+	}
+	else {
+		kprintf("Usage: sys [on|off|reset]\n");
+	}
+
+	return 0;
+}
+
 ////////////////////////////////////////
 //
 // Menus.
@@ -463,6 +551,7 @@ static const char *testmenu[] = {
 	"[km2] kmalloc stress test           ",
 	"[km3] Large kmalloc test            ",
 	"[km4] Multipage kmalloc test        ",
+	"[pid] Pid table test                ",
 	"[tt1] Thread test 1                 ",
 	"[tt2] Thread test 2                 ",
 	"[tt3] Thread test 3                 ",
@@ -473,7 +562,7 @@ static const char *testmenu[] = {
 	"[sy2] Lock test             (1)     ",
 	"[sy3] CV test               (1)     ",
 	"[sy4] CV test #2            (1)     ",
-	"[semu1-22] Semaphore unit tests     ",
+	"[semu1-25] Semaphore unit tests     ",
 	"[fs1] Filesystem test               ",
 	"[fs2] FS read stress                ",
 	"[fs3] FS write stress               ",
@@ -504,6 +593,10 @@ static const char *mainmenu[] = {
 	"[kh] Kernel heap stats              ",
 	"[khgen] Next kernel heap generation ",
 	"[khdump] Dump kernel heap           ",
+	"[sl] Run queue latency stats        ",
+	"[lks] Lock contention stats         ",
+	"[cnt] Per-cpu event counters        ",
+	"[sys] Syscall stats                 ",
 	"[q] Quit and shut down              ",
 	NULL
 };
@@ -553,6 +646,10 @@ static struct {
 	{ "kh",         cmd_kheapstats },
 	{ "khgen",      cmd_kheapgeneration },
 	{ "khdump",     cmd_kheapdump },
+	{ "sl",         cmd_schedlat },
+	{ "lks",        cmd_lockstat },
+	{ "cnt",        cmd_counters },
+	{ "sys",        cmd_syscalls },
 
 	/* base system tests */
 	{ "at",		arraytest },
@@ -563,6 +660,7 @@ static struct {
 	{ "km2",	kmallocstress },
 	{ "km3",	kmalloctest3 },
 	{ "km4",	kmalloctest4 },
+	{ "pid",	pidtest },
 #if OPT_NET
 	{ "net",	nettest },
 #endif
@@ -599,6 +697,9 @@ static struct {
 	{ "semu20",	semu20 },
 	{ "semu21",	semu21 },
 	{ "semu22",	semu22 },
+	{ "semu23",	semu23 },
+	{ "semu24",	semu24 },
+	{ "semu25",	semu25 },
 
 	/* file system assignment tests */
 	{ "fs1",	fstest },
@@ -52,11 +52,20 @@
 #include <kern/limits.h>
 #include <kern/wait.h>
 #include <copyinout.h>
+#include <lockstat.h>
+#include <rcu.h>
+#include <wchan.h>
 /*
  * The process for the kernel; this holds all the kernel-only threads.
  */
 struct proc* kproc;
-struct pid_list *pid_list = NULL;
+struct pid_table *pid_table = NULL;
+static struct lockstat pid_table_lockstat = LOCKSTAT_INITIALIZER("pid_table");
+
+/* Orphaned zombies waiting to be destroyed; see proc_exorcise */
+#define REAP_BATCH 2
+static struct proc *reap_queue = NULL;
+static struct spinlock reap_lock = SPINLOCK_INITIALIZER;
 
 /*
  * Create a proc structure.
@@ -86,35 +95,54 @@ proc_create(const char *name)
 	/* VFS fields */
 	proc->p_cwd = NULL;
 
-	/* Exit status/mailbox structure fields */
-	if((proc->p_exit_status.exit_sem = sem_create("exitsem", 0)) == NULL) {
+	/* Exit status and child list fields */
+	if((proc->p_childwait = wchan_create("childwait")) == NULL) {
+		kfree(proc->p_name);
 		kfree(proc);
 		return NULL;
 	}
+	proc->p_children = NULL;
+	proc->p_sibnext = NULL;
+	proc->p_sibprev = NULL;
+	proc->p_zombies = NULL;
+	proc->p_zombietail = &proc->p_zombies;
+	proc->p_zombienext = NULL;
+	proc->p_zombieprev = NULL;
 
 	/* Initialized standardly for consistency (note no real exit status < 0) */
 	proc->p_exit_status.exitcode = -1;	
 
 	/* Only forked processes should have exit statuses remain */
 	proc->p_es_needed.needed = 0;
+	proc->p_es_needed.exited = 0;
 	spinlock_init(&proc->p_es_needed.esn_lock);
 
-	/* At creation, process has no children->no exit mailboxes needed */
-	proc->child_esn_mailbox = NULL;
+	proc->p_reapnext = NULL;
+
+	/* Scheduling: default priority unless fork says otherwise */
+	proc->p_priority = 0;
+	proc->p_stride = PRIO_STRIDE(0);
+
+	/* Resource usage */
+	bzero(&proc->p_usage, sizeof(proc->p_usage));
+	bzero(&proc->p_cusage, sizeof(proc->p_cusage));
 
 	/* Before trying to allocate a new pid, clean out any zombie processes */
 	proc_exorcise();
 
 	/* PID allocation. */
 	if(new_pid(proc)) {
-		sem_destroy(proc->p_exit_status.exit_sem);
+		wchan_destroy(proc->p_childwait);
+		kfree(proc->p_name);
 		kfree(proc);
 		return NULL; 
 	}
 	/* if we are creating the kernel thread, it is parentless */
 	if(curthread) {
+		proc->p_parent = curthread->t_proc;
 		proc->ppid = curthread->t_proc->pid;
 	} else {
+		proc->p_parent = NULL;
 		proc->ppid = 0;
 	}
 	return proc;
@@ -125,6 +153,24 @@ proc_create(const char *name)
  * Note: nothing currently calls this. Your wait/exit code will
  * probably want to do so.
  */
+/*
+ * Last stage of proc_destroy, once no pid lookup can still see PROC.
+ */
+static
+void
+proc_free(void *data)
+{
+	struct proc *proc = data;
+
+	/* Exit structure clean-up */
+	wchan_destroy(proc->p_childwait);
+	spinlock_cleanup(&proc->p_es_needed.esn_lock);
+
+	spinlock_cleanup(&proc->p_lock);
+	kfree(proc->p_name);
+	kfree(proc);
+}
+
 void
 proc_destroy(struct proc *proc)
 {
@@ -201,14 +247,14 @@ proc_destroy(struct proc *proc)
 	}
 		
 	KASSERT(proc->p_numthreads == 0);
-	spinlock_cleanup(&proc->p_lock);
 
-	/* Exit structure clean-up */
-	sem_destroy(proc->p_exit_status.exit_sem);
-	spinlock_cleanup(&proc->p_es_needed.esn_lock);
-
-	kfree(proc->p_name);
-	kfree(proc);
+	/*
+	 * A pid lookup that started before remove_pid may still be
+	 * looking at (and locking) us, and an exiting child may still be
+	 * on its way out of esn_lock after handing itself to its parent
+	 * (see sys__exit), so free the rest later.
+	 */
+	call_rcu(&proc->p_rcu, proc_free, proc);
 }
 
 /*
@@ -217,8 +263,8 @@ proc_destroy(struct proc *proc)
 void
 proc_bootstrap(void)
 {
-	if(pid_list_init()) {
-		panic("pid_list initialization failed\n");
+	if(pid_table_init()) {
+		panic("pid_table initialization failed\n");
 	}
 	kproc = proc_create("[kernel]");
 	if (kproc == NULL) {
@@ -285,6 +331,7 @@ proc_create_fork(const char *name)
 		kfree(child_proc);
 		return NULL;
 	}
+	as_setkinfo(*addrspace_copy, child_proc->pid, child_proc->ppid);
 	proc_setas_other(child_proc, *addrspace_copy);
 	kfree(addrspace_copy);
 
@@ -295,6 +342,10 @@ proc_create_fork(const char *name)
 		VOP_INCREF(curproc->p_cwd);
 		child_proc->p_cwd = curproc->p_cwd;
 	}
+
+	/* children inherit the parent's priority */
+	child_proc->p_priority = curproc->p_priority;
+	child_proc->p_stride = curproc->p_stride;
 	
 	spinlock_release(&curproc->p_lock);
 
@@ -353,6 +404,9 @@ proc_remthread(struct thread *t)
 	spinlock_acquire(&proc->p_lock);
 	KASSERT(proc->p_numthreads > 0);
 	proc->p_numthreads--;
+	/* fold the thread's usage into the process totals */
+	threadusage_add(&proc->p_usage, &t->t_usage);
+	bzero(&t->t_usage, sizeof(t->t_usage));
 	spinlock_release(&proc->p_lock);
 
 	spl = splhigh();
@@ -419,163 +473,288 @@ proc_setas_other(struct proc *proc, struct addrspace *newas)
 	spinlock_release(&proc->p_lock);
 	return oldas;
 }
-/* called in proc_bootstrap to set up pid list before kproc created */
-int pid_list_init(void) {
-	/* create list and pid = __PID_MIN-1
-	 * (the first process created is the kernel process, and limits.h defines
-	 * __PID_MIN to correspond to the first user process)
-	 */
-	pid_list = kmalloc(sizeof(struct pid_list));
-	if(pid_list == NULL) {
+/* called in proc_bootstrap to set up pid table before kproc created */
+int pid_table_init(void) {
+	unsigned i, slot;
+
+	pid_table = kmalloc(sizeof(struct pid_table));
+	if(pid_table == NULL) {
 		return ENOMEM;
 	}
-	pid_list->size = 0;
-	spinlock_init(&pid_list->pl_lock);
-	//if list was NULL and could not alloc, must be out of memory
+	pid_table->size = 0;
+	pid_table->pt_freehead = 0;
+	pid_table->pt_nfree = 0;
+	for(slot = 0; slot < PID_SLOTS; slot++) {
+		pid_table->pt_procs[slot] = NULL;
+		/* so the first pid from each slot is the slot number */
+		pid_table->pt_pids[slot] = (pid_t)slot - PID_SLOTS;
+	}
+	/* queue the slots so pids come out in order: __PID_MIN first */
+	for(i = 0; i < PID_SLOTS; i++) {
+		slot = (i + __PID_MIN) % PID_SLOTS;
+		if(slot != (__PID_MIN-1) % PID_SLOTS) {
+			pid_table->pt_free[pid_table->pt_nfree++] = slot;
+		}
+	}
+	spinlock_init(&pid_table->pt_lock);
+	spinlock_setstat(&pid_table->pt_lock, &pid_table_lockstat);
 	return 0;
 }
-/* generates a new pid, adds to pid list, associates with passed process */
+
+/* the pid a slot hands out next */
+static pid_t pid_table_nextpid(unsigned slot) {
+	pid_t pid = pid_table->pt_pids[slot] + PID_SLOTS;
+
+	if(pid > __PID_MAX) {
+		pid = slot;
+	}
+	if(pid < __PID_MIN) {
+		pid += PID_SLOTS;
+	}
+	return pid;
+}
+
+/* generates a new pid, enters it in the table, associates it with process */
 int new_pid(struct proc *process) {
-	spinlock_acquire(&pid_list->pl_lock);
-	// if this is the first process, initialize 
-	if(pid_list->knode == NULL) {
-		struct pid_list_node *kn;
-		pid_list->knode = kmalloc(sizeof(struct pid_list_node));
-		kn = pid_list->knode;
-		if(kn == NULL) {
-			spinlock_release(&pid_list->pl_lock);
-			return ENOMEM;
-		}
-		kn->next = NULL;
-		kn->pid = __PID_MIN-1;
-		// associate process and pid
-		kn->proc = process;
-		process->pid = __PID_MIN-1;
+	unsigned slot;
+	pid_t pid;
+
+	spinlock_acquire(&pid_table->pt_lock);
+	if(pid_table->size == 0) {
+		/* this is the kernel process, which has a reserved slot */
+		slot = (__PID_MIN-1) % PID_SLOTS;
+		pid = __PID_MIN-1;
 	} else {
-		struct pid_list_node* prev =  pid_list->knode;
-		struct pid_list_node* cur = pid_list->knode->next;
-		int next_expected_pid = pid_list->knode->pid + 1;
-		while(cur != NULL && cur->pid == next_expected_pid) {
-			prev = prev->next;
-			cur = cur->next;
-			next_expected_pid++;
-		}
-		//When we get here, prev == the highest numbered process before a gap is reached
-		if(prev->pid == __PID_MAX) {
+		if(pid_table->pt_nfree == 0) {
 			//error for proc table being full
-			spinlock_release(&pid_list->pl_lock);
+			spinlock_release(&pid_table->pt_lock);
 			return ENPROC;
-		} 
-		cur = kmalloc(sizeof(struct pid_list_node));
-		//if n was NULL and could not alloc, must be out of memory
-		if(cur == NULL) {
-			spinlock_release(&pid_list->pl_lock);
-			return ENOMEM; 
 		}
-		cur->pid = prev->pid +1;
-		cur->next = prev->next;
-		prev->next = cur;
-		// associate process and pid
-		cur->proc = process;
-		process->pid = cur->pid;	
-	}
-	pid_list->size++;
-	spinlock_release(&pid_list->pl_lock);
+		// the head of the queue has been free the longest
+		slot = pid_table->pt_free[pid_table->pt_freehead];
+		pid_table->pt_freehead =
+			(pid_table->pt_freehead + 1) % PID_SLOTS;
+		pid_table->pt_nfree--;
+		pid = pid_table_nextpid(slot);
+	}
+	pid_table->pt_pids[slot] = pid;
+	// associate process and pid; publish only once pid is set
+	process->pid = pid;
+	rcu_assign(pid_table->pt_procs[slot], process);
+	pid_table->size++;
+	spinlock_release(&pid_table->pt_lock);
 	return 0;
 }
 
 // returns 0 if successful, error if not
 int remove_pid(pid_t p) {
-	spinlock_acquire(&pid_list->pl_lock);
-	if(p < __PID_MIN || p > __PID_MAX || pid_list->knode == NULL) {
+	unsigned slot, tail;
+
+	if(p < __PID_MIN || p > __PID_MAX) {
 		panic("Tried to remove an invalid PID");
 	}
-	struct pid_list_node* prev = pid_list->knode;
-	struct pid_list_node* cur = pid_list->knode->next;
-	while(cur != NULL && cur->pid != p) {
-		prev = cur;
-		cur = cur->next;
-	}
-	if(cur==NULL) {
-		//pid was not in list
-		spinlock_release(&pid_list->pl_lock);
-		kprintf("Tried to remove pid not in list\n");
+	slot = p % PID_SLOTS;
+
+	spinlock_acquire(&pid_table->pt_lock);
+	if(pid_table->pt_procs[slot] == NULL ||
+	   pid_table->pt_procs[slot]->pid != p) {
+		//pid was not in table
+		spinlock_release(&pid_table->pt_lock);
+		kprintf("Tried to remove pid not in table\n");
 		return EINVAL;
 	}
-	prev->next = cur->next;
-	cur->next = NULL;
-	kfree(cur);
-	pid_list->size--;
-	spinlock_release(&pid_list->pl_lock);
+	// a single store; lookups already holding the proc can keep using it
+	pid_table->pt_procs[slot] = NULL;
+	tail = (pid_table->pt_freehead + pid_table->pt_nfree) % PID_SLOTS;
+	pid_table->pt_free[tail] = slot;
+	pid_table->pt_nfree++;
+	pid_table->size--;
+	spinlock_release(&pid_table->pt_lock);
 	return 0;
 }
 
-int get_exit_code(pid_t pid, userptr_t status, struct proc **proc) {
-	struct pid_list_node *cur;	
-	struct exit_status *es;	
-	int pid_found = 0;
-
-	spinlock_acquire(&pid_list->pl_lock);
-	/* first process/pid will have been initialized by proc_bootstrap */
-	cur = pid_list->knode->next;
-	/* search list for entry with matching pid */
-	while(cur && !pid_found) {
-		if(pid == cur->pid) {
-			es = &cur->proc->p_exit_status;		
-			pid_found = 1;
-			/* reference used by waitpid to destroy process */
-			*proc = cur->proc;
-		} else {
-			cur = cur->next;
-		}
+/*
+ * Finds the process with the given pid, or NULL if there is none. Caller
+ * must be inside rcu_read_lock(), which also keeps the process from being
+ * freed (proc_destroy goes through call_rcu).
+ */
+struct proc *pid_table_find(pid_t pid) {
+	struct proc *proc;
+
+	if(pid < 0) {
+		return NULL;
+	}
+	proc = rcu_deref(pid_table->pt_procs[pid % PID_SLOTS]);
+	if(proc == NULL || proc->pid != pid) {
+		return NULL;
 	}
-	spinlock_release(&pid_list->pl_lock);
-	if(cur->proc->ppid != curthread->t_proc->pid) {
-		return ECHILD;
+	return proc;
+}
+
+/*
+ * Link a newly forked child onto its parent's list of children.
+ */
+void proc_add_child(struct proc *parent, struct proc *child) {
+	KASSERT(spinlock_do_i_hold(&parent->p_lock));
+	KASSERT(child->p_sibprev == NULL);
+
+	child->p_sibnext = parent->p_children;
+	if(parent->p_children != NULL) {
+		parent->p_children->p_sibprev = &child->p_sibnext;
 	}
-	if(!pid_found) {
+	child->p_sibprev = &parent->p_children;
+	parent->p_children = child;
+}
+
+/*
+ * Unlink a reaped child from its parent's list of children.
+ */
+void proc_remove_child(struct proc *parent, struct proc *child) {
+	KASSERT(spinlock_do_i_hold(&parent->p_lock));
+	KASSERT(child->p_sibprev != NULL);
+
+	*child->p_sibprev = child->p_sibnext;
+	if(child->p_sibnext != NULL) {
+		child->p_sibnext->p_sibprev = child->p_sibprev;
+	}
+	child->p_sibnext = NULL;
+	child->p_sibprev = NULL;
+}
+
+/*
+ * Called by an exiting child whose parent still wants its exit status:
+ * queue it for the parent's waitpid and wake the parent up.
+ */
+void proc_add_zombie(struct proc *parent, struct proc *child) {
+	KASSERT(spinlock_do_i_hold(&parent->p_lock));
+
+	child->p_zombienext = NULL;
+	child->p_zombieprev = parent->p_zombietail;
+	*parent->p_zombietail = child;
+	parent->p_zombietail = &child->p_zombienext;
+	wchan_wakeall(parent->p_childwait, &parent->p_lock);
+}
+
+/*
+ * Take an exited child off the parent's queue: the oldest one if child
+ * is NULL, otherwise that child. Returns NULL if there is no such
+ * zombie (yet).
+ */
+struct proc *proc_take_zombie(struct proc *parent, struct proc *child) {
+	KASSERT(spinlock_do_i_hold(&parent->p_lock));
+
+	if(child == NULL) {
+		child = parent->p_zombies;
+	}
+	if(child == NULL || child->p_zombieprev == NULL) {
+		return NULL;
+	}
+	*child->p_zombieprev = child->p_zombienext;
+	if(child->p_zombienext != NULL) {
+		child->p_zombienext->p_zombieprev = child->p_zombieprev;
+	} else {
+		parent->p_zombietail = child->p_zombieprev;
+	}
+	child->p_zombienext = NULL;
+	child->p_zombieprev = NULL;
+	return child;
+}
+
+/*
+ * Queue an orphaned zombie for proc_exorcise. Called by the exiting
+ * parent, which is the only one left that knows about the child.
+ */
+void proc_orphan_zombie(struct proc *proc) {
+	spinlock_acquire(&reap_lock);
+	proc->p_reapnext = reap_queue;
+	reap_queue = proc;
+	spinlock_release(&reap_lock);
+}
+
+/*
+ * Removes zombie processes: destroys up to REAP_BATCH procs from the
+ * reap queue, so the cost doesn't depend on how many processes exist.
+ * Each call reaps more than one, so the queue can't grow without bound
+ * as long as processes keep being created.
+ */
+void proc_exorcise(void) {
+	struct proc *proc;
+	int i;
+
+	for(i = 0; i < REAP_BATCH; i++) {
+		spinlock_acquire(&reap_lock);
+		proc = reap_queue;
+		if(proc != NULL) {
+			reap_queue = proc->p_reapnext;
+		}
+		spinlock_release(&reap_lock);
+		if(proc == NULL) {
+			break;
+		}
+		proc_destroy(proc);
+	}
+}
+/* Gets the priority of the process with the given pid */
+int proc_getpriority(pid_t pid, int *prio) {
+	struct proc *proc;
+
+	rcu_read_lock();
+	proc = pid_table_find(pid);
+	if(proc == NULL) {
+		rcu_read_unlock();
 		return ESRCH;
 	}
-	/* wait on sem until child signals a set exit code */
-	P(es->exit_sem);
-	
-	copyout(&es->exitcode, status, sizeof(int));
+	*prio = proc->p_priority;
+	rcu_read_unlock();
 	return 0;
 }
+
 /*
- * Removes zombie processes. Creates a temporary array of proc * that
- * will be destroyed once all processes have been considered. Necessary
- * because proc_destroy alters the exit needed flag of any child process.
+ * True if PROC is ANCESTOR or one of its descendants. Call inside an
+ * RCU read section: an exiting parent clears its children's p_parent,
+ * and isn't freed until readers that might still see it are done.
  */
-void proc_exorcise(void) {
-	int lastidx = 0;
-	spinlock_acquire(&pid_list->pl_lock);
-	struct proc *to_destroy[pid_list->size];
-	/* No need to look if the kernel proc is the only (indeed 
-	 * doing so will segfault
-	 */
-	if(pid_list->size > 1 && pid_list->knode) {
-		struct pid_list_node *cur;
-		struct proc *cur_proc;
-		/* we assume kernel proc is resident since
-		 * operating system running
-		 */
-		cur = pid_list->knode->next;
-		while(cur) {
-			cur_proc = cur->proc;
-			spinlock_acquire(&cur_proc->p_lock);
-			if(cur_proc->p_exit_status.exitcode != -1 &&
-			   cur_proc->p_es_needed.needed == 0) {
-				to_destroy[lastidx++] = cur_proc;		
-			} 
-			spinlock_release(&cur_proc->p_lock);
-			cur = cur->next;
+static bool proc_is_descendant(struct proc *proc, struct proc *ancestor) {
+	while(proc != NULL) {
+		if(proc == ancestor) {
+			return true;
 		}
+		proc = proc->p_parent;
 	}
-	spinlock_release(&pid_list->pl_lock);
+	return false;
+}
 
-	int i;
-	for(i = 0; i < lastidx; i++) {
-		proc_destroy(to_destroy[i]);
+/*
+ * Sets the priority of the process with the given pid, clamping it to
+ * PRIO_MIN..PRIO_MAX like Unix does. Takes effect at the process's
+ * next hardclock. There are no users, so the rule is that a process
+ * may renice itself and its descendants and nothing else; the kernel
+ * process is never fair game.
+ */
+int proc_setpriority(pid_t pid, int prio) {
+	struct proc *proc;
+
+	if(prio < PRIO_MIN) {
+		prio = PRIO_MIN;
+	}
+	if(prio > PRIO_MAX) {
+		prio = PRIO_MAX;
 	}
+
+	rcu_read_lock();
+	proc = pid_table_find(pid);
+	if(proc == NULL) {
+		rcu_read_unlock();
+		return ESRCH;
+	}
+	if(proc == kproc || !proc_is_descendant(proc, curthread->t_proc)) {
+		rcu_read_unlock();
+		return EPERM;
+	}
+	spinlock_acquire(&proc->p_lock);
+	proc->p_priority = prio;
+	proc->p_stride = PRIO_STRIDE(prio);
+	spinlock_release(&proc->p_lock);
+	rcu_read_unlock();
+	return 0;
 }
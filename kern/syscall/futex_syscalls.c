@@ -0,0 +1,134 @@
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/futex.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <wchan.h>
+#include <addrspace.h>
+#include <vm.h>
+#include <proc.h>
+#include <current.h>
+#include <syscall.h>
+
+/*
+ * Futexes: sleep on a user address, but only if it holds an expected
+ * value. This lets userland do uncontended locking entirely with
+ * atomic ops on its own memory and enter the kernel only to block or
+ * to wake someone.
+ *
+ * Sleeping threads are hashed by the physical address of the futex
+ * word into a fixed table of buckets, each with its own spinlock and
+ * wait channel. The waiter records live on the sleepers' kernel stacks.
+ * FUTEX_WAKE wakes each thread it picks individually, so sleepers on
+ * other addresses that share the bucket stay asleep.
+ */
+
+#define FUTEX_HASHSIZE 64
+#define FUTEX_HASH(pa) ((((pa) >> 2) ^ ((pa) >> 12)) % FUTEX_HASHSIZE)
+
+struct futex_waiter {
+	paddr_t fw_paddr;		/* futex word this thread waits on */
+	struct thread *fw_thread;	/* the sleeping thread */
+	bool fw_woken;			/* set by FUTEX_WAKE */
+	struct futex_waiter *fw_next;
+};
+
+struct futex_bucket {
+	struct spinlock fb_lock;	/* protects everything here */
+	struct wchan *fb_wchan;		/* where the waiters sleep */
+	struct futex_waiter *fb_waiters; /* in arrival order */
+};
+
+static struct futex_bucket futex_table[FUTEX_HASHSIZE];
+
+/* Called once during system startup. */
+void futex_bootstrap(void) {
+	unsigned i;
+
+	for(i = 0; i < FUTEX_HASHSIZE; i++) {
+		spinlock_init(&futex_table[i].fb_lock);
+		futex_table[i].fb_wchan = wchan_create("futex");
+		if(futex_table[i].fb_wchan == NULL) {
+			panic("futex_bootstrap: wchan_create failed\n");
+		}
+		futex_table[i].fb_waiters = NULL;
+	}
+}
+
+/*
+ * FUTEX_WAIT. The value is read through the kernel's direct mapping of
+ * physical memory while holding the bucket lock, so it can't fault and
+ * a FUTEX_WAKE from whoever changes it can't slip in before we sleep.
+ */
+static int futex_wait(struct futex_bucket *fb, paddr_t pa, int val) {
+	struct futex_waiter me, **pp;
+
+	spinlock_acquire(&fb->fb_lock);
+	if(*(volatile int *)PADDR_TO_KVADDR(pa) != val) {
+		spinlock_release(&fb->fb_lock);
+		return EAGAIN;
+	}
+	me.fw_paddr = pa;
+	me.fw_thread = curthread;
+	me.fw_woken = false;
+	me.fw_next = NULL;
+	for(pp = &fb->fb_waiters; *pp; pp = &(*pp)->fw_next);
+	*pp = &me;
+
+	while(!me.fw_woken) {
+		wchan_sleep(fb->fb_wchan, &fb->fb_lock);
+	}
+	spinlock_release(&fb->fb_lock);
+	return 0;
+}
+
+/* FUTEX_WAKE: wakes the first N waiters on pa, returns how many. */
+static int futex_wake(struct futex_bucket *fb, paddr_t pa, int n) {
+	struct futex_waiter *w, **pp;
+	int woken = 0;
+
+	spinlock_acquire(&fb->fb_lock);
+	pp = &fb->fb_waiters;
+	while((w = *pp) != NULL && woken < n) {
+		if(w->fw_paddr == pa) {
+			*pp = w->fw_next;
+			w->fw_woken = true;
+			/* it's asleep: it queued itself and slept under fb_lock */
+			wchan_wakethread(fb->fb_wchan, &fb->fb_lock, w->fw_thread);
+			woken++;
+		} else {
+			pp = &w->fw_next;
+		}
+	}
+	spinlock_release(&fb->fb_lock);
+	return woken;
+}
+
+int sys_futex(userptr_t uaddr, int op, int val, int32_t *retval) {
+	struct addrspace *as;
+	paddr_t pa;
+	int result;
+
+	if((vaddr_t)uaddr % sizeof(int) != 0) {
+		return EINVAL;
+	}
+	as = proc_getas();
+	if(as == NULL || (vaddr_t)uaddr >= USERSPACETOP) {
+		return EFAULT;
+	}
+	result = as_translate(as, (vaddr_t)uaddr, &pa);
+	if(result) {
+		return result;
+	}
+
+	switch(op) {
+	case FUTEX_WAIT:
+		*retval = 0;
+		return futex_wait(&futex_table[FUTEX_HASH(pa)], pa, val);
+	case FUTEX_WAKE:
+		*retval = futex_wake(&futex_table[FUTEX_HASH(pa)], pa, val);
+		return 0;
+	default:
+		return EINVAL;
+	}
+}
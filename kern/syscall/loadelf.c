@@ -57,6 +57,9 @@
 #include <proc.h>
 #include <current.h>
 #include <addrspace.h>
+#include <spinlock.h>
+#include <copyinout.h>
+#include <counter.h>
 #include <vnode.h>
 #include <elf.h>
 
@@ -146,21 +149,353 @@ load_segment(struct addrspace *as, struct vnode *v,
 }
 
 /*
- * Load an ELF executable user program into the current address space.
+ * Exec image cache.
  *
- * Returns the entry point (initial PC) for the program in ENTRYPOINT.
+ * Shells and the like exec the same few programs over and over, so
+ * rather than reading and checking the headers and reading every
+ * segment from disk on each exec, keep the results of the last few
+ * loads around: the entry point, the PT_LOAD program headers, and a
+ * copy of each segment's file contents. A hit skips reading and
+ * checking the headers, and the segments are copied straight out into
+ * the new address space with no disk I/O. (Every address space has its
+ * own physical memory, so we can't map the cached text pages read-only
+ * and share them; copying them is the next best thing.)
+ *
+ * Segment contents live in a pool of EXECCACHE_POOLPAGES pages that
+ * execcache_bootstrap allocates once and that is never freed; images
+ * take pages from it and give them back when destroyed. Nothing is
+ * kmalloc'd per segment, so this works under dumbvm, whose
+ * free_kpages does nothing. If the pool is short, the least recently
+ * used images are evicted to make room; an image that still won't fit,
+ * or whose segments need more than EXECCACHE_MAXPAGES pages, is cached
+ * with its headers only and its segments are read from the file.
+ *
+ * Images are keyed by vnode, and each holds a reference to its vnode
+ * so the key stays valid. VOP_WRITE and VOP_TRUNCATE bump the vnode's
+ * write generation; an image remembers the generation it was read at
+ * and is only used, or cached at all, if the vnode still has that
+ * generation. Nothing is cached or looked up while a write is in
+ * progress (see vnode_writegen).
+ *
+ * Images are refcounted so one can be evicted while a load from it is
+ * still copying; the cache itself holds one reference.
+ */
+
+#define EXECCACHE_SIZE		8
+#define EXECCACHE_MAXSEGS	8
+#define EXECCACHE_POOLPAGES	32
+#define EXECCACHE_MAXPAGES	16
+
+struct exec_segment {
+	vaddr_t es_vaddr;
+	size_t es_memsz;
+	size_t es_filesz;
+	off_t es_offset;
+	uint32_t es_flags;		/* PF_R, PF_W, PF_X */
+	bool es_cached;			/* contents are in ei_pages */
+	unsigned es_firstpage;		/* ...starting at this index */
+};
+
+struct exec_image {
+	struct vnode *ei_vnode;		/* file it came from; holds a ref */
+	unsigned ei_writegen;		/* write generation when read */
+	vaddr_t ei_entry;		/* entry point */
+	unsigned ei_nsegs;
+	struct exec_segment ei_segs[EXECCACHE_MAXSEGS];
+	unsigned ei_npages;		/* pool pages held */
+	unsigned ei_pages[EXECCACHE_MAXPAGES];
+	unsigned ei_refcount;		/* loads in progress, +1 if cached */
+	unsigned ei_lastuse;		/* execcache_clock at last use */
+};
+
+static struct spinlock execcache_lock = SPINLOCK_INITIALIZER;
+static struct exec_image *execcache[EXECCACHE_SIZE];
+static unsigned execcache_clock;
+
+/* The segment pool; the free page numbers are a stack. */
+static char *execcache_pool;
+static unsigned execcache_freepages[EXECCACHE_POOLPAGES];
+static unsigned execcache_nfree;
+
+static struct counter execcache_hits = COUNTER_INITIALIZER("exec cache hits");
+static struct counter execcache_misses =
+	COUNTER_INITIALIZER("exec cache misses");
+
+/*
+ * Free an image whose last reference has gone away.
+ * Must not be called with execcache_lock held (VOP_DECREF may sleep).
+ */
+static
+void
+exec_image_destroy(struct exec_image *img)
+{
+	unsigned i;
+
+	KASSERT(img->ei_refcount == 0);
+	if (img->ei_npages > 0) {
+		spinlock_acquire(&execcache_lock);
+		for (i=0; i<img->ei_npages; i++) {
+			KASSERT(execcache_nfree < EXECCACHE_POOLPAGES);
+			execcache_freepages[execcache_nfree++] =
+				img->ei_pages[i];
+		}
+		spinlock_release(&execcache_lock);
+	}
+	VOP_DECREF(img->ei_vnode);
+	kfree(img);
+}
+
+/*
+ * Drop a reference with execcache_lock held. Returns true if that was
+ * the last one and the caller should destroy the image after unlocking.
  */
+static
+bool
+exec_image_unref(struct exec_image *img)
+{
+	KASSERT(spinlock_do_i_hold(&execcache_lock));
+	KASSERT(img->ei_refcount > 0);
+	img->ei_refcount--;
+	return img->ei_refcount == 0;
+}
+
+static
+void
+exec_image_release(struct exec_image *img)
+{
+	bool destroy;
+
+	spinlock_acquire(&execcache_lock);
+	destroy = exec_image_unref(img);
+	spinlock_release(&execcache_lock);
+
+	if (destroy) {
+		exec_image_destroy(img);
+	}
+}
+
+/*
+ * Look for V in the cache. Returns the image with a reference added,
+ * or NULL. An image for V that's out of date is thrown away.
+ */
+static
+struct exec_image *
+execcache_lookup(struct vnode *v, unsigned writegen)
+{
+	struct exec_image *img, *stale;
+	bool destroy;
+	unsigned i;
+
+	img = NULL;
+	stale = NULL;
+	destroy = false;
+
+	spinlock_acquire(&execcache_lock);
+	for (i=0; i<EXECCACHE_SIZE; i++) {
+		if (execcache[i] == NULL || execcache[i]->ei_vnode != v) {
+			continue;
+		}
+		if (execcache[i]->ei_writegen == writegen) {
+			img = execcache[i];
+			img->ei_refcount++;
+			img->ei_lastuse = ++execcache_clock;
+		}
+		else {
+			stale = execcache[i];
+			execcache[i] = NULL;
+			destroy = exec_image_unref(stale);
+		}
+		break;
+	}
+	spinlock_release(&execcache_lock);
+
+	if (destroy) {
+		exec_image_destroy(stale);
+	}
+	return img;
+}
+
+/*
+ * Add IMG to the cache, evicting the least recently used image if
+ * there's no free slot. Does nothing if the file has been written
+ * since IMG was read, or if another exec already cached it. (A write
+ * that slips in after the check is caught by execcache_lookup.)
+ */
+static
+void
+execcache_insert(struct exec_image *img)
+{
+	struct exec_image *victim;
+	unsigned i, slot, writegen;
+	bool destroy;
+
+	if (!vnode_writegen(img->ei_vnode, &writegen) ||
+	    writegen != img->ei_writegen) {
+		return;
+	}
+
+	victim = NULL;
+	destroy = false;
+
+	spinlock_acquire(&execcache_lock);
+	for (i=0; i<EXECCACHE_SIZE; i++) {
+		if (execcache[i] != NULL &&
+		    execcache[i]->ei_vnode == img->ei_vnode) {
+			spinlock_release(&execcache_lock);
+			return;
+		}
+	}
+	slot = 0;
+	for (i=0; i<EXECCACHE_SIZE; i++) {
+		if (execcache[i] == NULL) {
+			slot = i;
+			break;
+		}
+		if (execcache[i]->ei_lastuse < execcache[slot]->ei_lastuse) {
+			slot = i;
+		}
+	}
+	if (execcache[slot] != NULL) {
+		victim = execcache[slot];
+		destroy = exec_image_unref(victim);
+	}
+	img->ei_refcount++;
+	img->ei_lastuse = ++execcache_clock;
+	execcache[slot] = img;
+	spinlock_release(&execcache_lock);
+
+	if (destroy) {
+		exec_image_destroy(victim);
+	}
+}
+
+/*
+ * Take NPAGES pool pages for IMG, evicting least recently used images
+ * that hold pages until there are enough. Returns false if there
+ * still aren't; pages of an evicted image that a load is still copying
+ * from only come back when that load finishes.
+ */
+static
+bool
+execcache_getpages(struct exec_image *img, unsigned npages)
+{
+	struct exec_image *victim;
+	unsigned i, slot;
+	bool destroy;
+
+	KASSERT(img->ei_npages == 0);
+	KASSERT(npages <= EXECCACHE_MAXPAGES);
+
+	while (1) {
+		spinlock_acquire(&execcache_lock);
+		if (execcache_nfree >= npages) {
+			for (i=0; i<npages; i++) {
+				img->ei_pages[i] =
+					execcache_freepages[--execcache_nfree];
+			}
+			img->ei_npages = npages;
+			spinlock_release(&execcache_lock);
+			return true;
+		}
+
+		victim = NULL;
+		slot = 0;
+		for (i=0; i<EXECCACHE_SIZE; i++) {
+			if (execcache[i] == NULL ||
+			    execcache[i]->ei_npages == 0) {
+				continue;
+			}
+			if (victim == NULL ||
+			    execcache[i]->ei_lastuse < victim->ei_lastuse) {
+				victim = execcache[i];
+				slot = i;
+			}
+		}
+		if (victim == NULL) {
+			spinlock_release(&execcache_lock);
+			return false;
+		}
+		execcache[slot] = NULL;
+		destroy = exec_image_unref(victim);
+		spinlock_release(&execcache_lock);
+
+		if (destroy) {
+			exec_image_destroy(victim);
+		}
+	}
+}
+
+/*
+ * Address of pool page PAGE.
+ */
+static
+void *
+execcache_page(unsigned page)
+{
+	KASSERT(page < EXECCACHE_POOLPAGES);
+	return execcache_pool + page * PAGE_SIZE;
+}
+
+/*
+ * Allocate the segment pool. If there isn't memory for it, images are
+ * cached with their headers only.
+ */
+void
+execcache_bootstrap(void)
+{
+	unsigned i;
+
+	execcache_pool = kmalloc(EXECCACHE_POOLPAGES * PAGE_SIZE);
+	if (execcache_pool == NULL) {
+		kprintf("execcache: no memory for segment pool\n");
+		return;
+	}
+	for (i=0; i<EXECCACHE_POOLPAGES; i++) {
+		execcache_freepages[i] = i;
+	}
+	execcache_nfree = EXECCACHE_POOLPAGES;
+}
+
+/*
+ * Empty the cache, dropping its vnode references. Called before
+ * unmounting, since a cached image keeps its filesystem busy.
+ */
+void
+execcache_purge(void)
+{
+	struct exec_image *img;
+	bool destroy;
+	unsigned i;
+
+	for (i=0; i<EXECCACHE_SIZE; i++) {
+		spinlock_acquire(&execcache_lock);
+		img = execcache[i];
+		execcache[i] = NULL;
+		destroy = img != NULL && exec_image_unref(img);
+		spinlock_release(&execcache_lock);
+
+		if (destroy) {
+			exec_image_destroy(img);
+		}
+	}
+}
+
+/*
+ * Read the executable header and the program headers of V into a new
+ * image. Nothing is done to the address space yet.
+ */
+static
 int
-load_elf(struct vnode *v, vaddr_t *entrypoint)
+exec_image_read(struct vnode *v, unsigned writegen,
+		struct exec_image **ret)
 {
 	Elf_Ehdr eh;   /* Executable header */
 	Elf_Phdr ph;   /* "Program header" = segment header */
-	int result, i;
+	struct exec_image *img;
+	struct exec_segment *seg;
 	struct iovec iov;
 	struct uio ku;
-	struct addrspace *as;
-
-	as = proc_getas();
+	int result, i;
 
 	/*
 	 * Read the executable header from offset 0 in the file.
@@ -202,13 +537,26 @@ load_elf(struct vnode *v, vaddr_t *entrypoint)
 		return ENOEXEC;
 	}
 
+	img = kmalloc(sizeof(*img));
+	if (img == NULL) {
+		return ENOMEM;
+	}
+	VOP_INCREF(v);
+	img->ei_vnode = v;
+	img->ei_writegen = writegen;
+	img->ei_entry = eh.e_entry;
+	img->ei_nsegs = 0;
+	img->ei_npages = 0;
+	img->ei_refcount = 1;
+	img->ei_lastuse = 0;
+
 	/*
-	 * Go through the list of segments and set up the address space.
+	 * Go through the list of segments and record the ones to load.
 	 *
 	 * Ordinarily there will be one code segment, one read-only
 	 * data segment, and one data/bss segment, but there might
-	 * conceivably be more. You don't need to support such files
-	 * if it's unduly awkward to do so.
+	 * conceivably be more. We give up past EXECCACHE_MAXSEGS;
+	 * dumbvm can't take more than two anyway.
 	 *
 	 * Note that the expression eh.e_phoff + i*eh.e_phentsize is
 	 * mandated by the ELF standard - we use sizeof(ph) to load,
@@ -223,13 +571,14 @@ load_elf(struct vnode *v, vaddr_t *entrypoint)
 
 		result = VOP_READ(v, &ku);
 		if (result) {
-			return result;
+			goto fail;
 		}
 
 		if (ku.uio_resid != 0) {
 			/* short read; problem with executable? */
 			kprintf("ELF: short read on phdr - file truncated?\n");
-			return ENOEXEC;
+			result = ENOEXEC;
+			goto fail;
 		}
 
 		switch (ph.p_type) {
@@ -240,68 +589,221 @@ load_elf(struct vnode *v, vaddr_t *entrypoint)
 		    default:
 			kprintf("loadelf: unknown segment type %d\n",
 				ph.p_type);
-			return ENOEXEC;
+			result = ENOEXEC;
+			goto fail;
 		}
 
-		result = as_define_region(as,
-					  ph.p_vaddr, ph.p_memsz,
-					  ph.p_flags & PF_R,
-					  ph.p_flags & PF_W,
-					  ph.p_flags & PF_X);
-		if (result) {
-			return result;
+		if (img->ei_nsegs == EXECCACHE_MAXSEGS) {
+			kprintf("loadelf: too many segments\n");
+			result = ENOEXEC;
+			goto fail;
 		}
+
+		if (ph.p_filesz > ph.p_memsz) {
+			kprintf("ELF: warning: segment filesize > "
+				"segment memsize\n");
+			ph.p_filesz = ph.p_memsz;
+		}
+
+		seg = &img->ei_segs[img->ei_nsegs++];
+		seg->es_vaddr = ph.p_vaddr;
+		seg->es_memsz = ph.p_memsz;
+		seg->es_filesz = ph.p_filesz;
+		seg->es_offset = ph.p_offset;
+		seg->es_flags = ph.p_flags;
+		seg->es_cached = false;
+		seg->es_firstpage = 0;
 	}
 
-	result = as_prepare_load(as);
-	if (result) {
-		return result;
+	*ret = img;
+	return 0;
+
+ fail:
+	exec_image_release(img);
+	return result;
+}
+
+/*
+ * Read the file contents of each segment of IMG into pool pages so
+ * they can be cached. If the image is too big, or the pool can't make
+ * room for it, leave the segments uncached and let the load read the
+ * file.
+ */
+static
+int
+exec_image_readdata(struct exec_image *img)
+{
+	struct exec_segment *seg;
+	struct iovec iov;
+	struct uio ku;
+	size_t done, len;
+	unsigned npages, page, i;
+	int result;
+
+	if (execcache_pool == NULL) {
+		return 0;
 	}
 
-	/*
-	 * Now actually load each segment.
-	 */
+	npages = 0;
+	for (i=0; i<img->ei_nsegs; i++) {
+		npages += DIVROUNDUP(img->ei_segs[i].es_filesz, PAGE_SIZE);
+		if (npages > EXECCACHE_MAXPAGES) {
+			return 0;
+		}
+	}
+	if (npages == 0 || !execcache_getpages(img, npages)) {
+		return 0;
+	}
 
-	for (i=0; i<eh.e_phnum; i++) {
-		off_t offset = eh.e_phoff + i*eh.e_phentsize;
-		uio_kinit(&iov, &ku, &ph, sizeof(ph), offset, UIO_READ);
+	page = 0;
+	for (i=0; i<img->ei_nsegs; i++) {
+		seg = &img->ei_segs[i];
+		seg->es_firstpage = page;
+		for (done = 0; done < seg->es_filesz; done += len) {
+			len = seg->es_filesz - done;
+			if (len > PAGE_SIZE) {
+				len = PAGE_SIZE;
+			}
+			uio_kinit(&iov, &ku,
+				  execcache_page(img->ei_pages[page++]), len,
+				  seg->es_offset + done, UIO_READ);
+			result = VOP_READ(img->ei_vnode, &ku);
+			if (result) {
+				return result;
+			}
+			if (ku.uio_resid != 0) {
+				/* short read; problem with executable? */
+				kprintf("ELF: short read on segment - "
+					"file truncated?\n");
+				return ENOEXEC;
+			}
+		}
+		seg->es_cached = true;
+	}
+	KASSERT(page == npages);
+	return 0;
+}
 
-		result = VOP_READ(v, &ku);
+/*
+ * Copy a cached segment out of the pool into the current address
+ * space. copyout checks that the destination is in user space, as
+ * uiomove does in load_segment.
+ */
+static
+int
+exec_segment_copyout(struct exec_image *img, struct exec_segment *seg)
+{
+	size_t done, len;
+	unsigned page;
+	int result;
+
+	DEBUG(DB_EXEC, "ELF: Copying %lu cached bytes to 0x%lx\n",
+	      (unsigned long) seg->es_filesz,
+	      (unsigned long) seg->es_vaddr);
+
+	page = seg->es_firstpage;
+	for (done = 0; done < seg->es_filesz; done += len) {
+		len = seg->es_filesz - done;
+		if (len > PAGE_SIZE) {
+			len = PAGE_SIZE;
+		}
+		result = copyout(execcache_page(img->ei_pages[page++]),
+				 (userptr_t)(seg->es_vaddr + done), len);
 		if (result) {
 			return result;
 		}
+	}
+	return 0;
+}
 
-		if (ku.uio_resid != 0) {
-			/* short read; problem with executable? */
-			kprintf("ELF: short read on phdr - file truncated?\n");
-			return ENOEXEC;
+/*
+ * Load an ELF executable user program into the current address space.
+ *
+ * Returns the entry point (initial PC) for the program in ENTRYPOINT.
+ */
+int
+load_elf(struct vnode *v, vaddr_t *entrypoint)
+{
+	struct exec_image *img;
+	struct exec_segment *seg;
+	struct addrspace *as;
+	unsigned writegen, i;
+	bool cacheable;
+	int result;
+
+	as = proc_getas();
+
+	/* If the file is being written, bypass the cache entirely. */
+	cacheable = vnode_writegen(v, &writegen);
+	img = cacheable ? execcache_lookup(v, writegen) : NULL;
+	if (img != NULL) {
+		counter_inc(&execcache_hits);
+	}
+	else {
+		counter_inc(&execcache_misses);
+		result = exec_image_read(v, writegen, &img);
+		if (result) {
+			return result;
+		}
+		if (cacheable) {
+			result = exec_image_readdata(img);
+			if (result) {
+				exec_image_release(img);
+				return result;
+			}
+			execcache_insert(img);
 		}
+	}
 
-		switch (ph.p_type) {
-		    case PT_NULL: /* skip */ continue;
-		    case PT_PHDR: /* skip */ continue;
-		    case PT_MIPS_REGINFO: /* skip */ continue;
-		    case PT_LOAD: break;
-		    default:
-			kprintf("loadelf: unknown segment type %d\n",
-				ph.p_type);
-			return ENOEXEC;
+	/*
+	 * Set up the address space.
+	 */
+
+	for (i=0; i<img->ei_nsegs; i++) {
+		seg = &img->ei_segs[i];
+		result = as_define_region(as,
+					  seg->es_vaddr, seg->es_memsz,
+					  seg->es_flags & PF_R,
+					  seg->es_flags & PF_W,
+					  seg->es_flags & PF_X);
+		if (result) {
+			goto done;
 		}
+	}
 
-		result = load_segment(as, v, ph.p_offset, ph.p_vaddr,
-				      ph.p_memsz, ph.p_filesz,
-				      ph.p_flags & PF_X);
+	result = as_prepare_load(as);
+	if (result) {
+		goto done;
+	}
+
+	/*
+	 * Now actually load each segment.
+	 */
+
+	for (i=0; i<img->ei_nsegs; i++) {
+		seg = &img->ei_segs[i];
+		if (seg->es_cached) {
+			result = exec_segment_copyout(img, seg);
+		}
+		else {
+			result = load_segment(as, v, seg->es_offset,
+					      seg->es_vaddr,
+					      seg->es_memsz, seg->es_filesz,
+					      seg->es_flags & PF_X);
+		}
 		if (result) {
-			return result;
+			goto done;
 		}
 	}
 
 	result = as_complete_load(as);
 	if (result) {
-		return result;
+		goto done;
 	}
 
-	*entrypoint = eh.e_entry;
+	*entrypoint = img->ei_entry;
 
-	return 0;
+ done:
+	exec_image_release(img);
+	return result;
 }
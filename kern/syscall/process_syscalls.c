@@ -9,139 +9,171 @@
 #include <kern/limits.h> //to get the __PID_MIN and __PID_MAX macros
 #include <limits.h>
 #include <kern/fcntl.h>
+#include <clock.h>
+#include <kern/resource.h>
 #include <lib.h>
 #include <vm.h>
 #include <vfs.h>
 #include <uio.h>
+#include <kern/wait.h>
+#include <rcu.h>
+#include <wchan.h>
 
 //defined in machine-dependent types.h, evals to signed 32-bit int for MIPS
 
 //In Linux getpid is always successful, so errno should be set to 0 in syscall.c
 //Returns the pid of the current thread's parent process
+//A process's pid never changes, so no lock is needed. (libc's getpid()
+//reads it from the kinfo page and doesn't come here at all.)
 int sys_getpid(int32_t *pid) {
-	spinlock_acquire(&curthread->t_proc->p_lock);
 	*pid = curthread->t_proc->pid;
-	spinlock_release(&curthread->t_proc->p_lock);
 
  	return(0);
 }
 
 int sys_waitpid(pid_t pid, userptr_t status, int options, pid_t *retpid) {
+	struct proc *proc = curthread->t_proc;
+	struct proc *child_proc;
+	struct proc *zombie;
+	int exitcode;
+
 	if(status == NULL) {
 		return EFAULT;
 	}
-	if(options) {
+	if(options & ~WNOHANG) {
 		return EINVAL;
 	}
-	int err;
-	struct proc *child_proc;
-	/* get exit code and store in status location; destroy child */
-	if((err = get_exit_code(pid, status, &child_proc)) < 0) {
-		return err;
-	}
-	*retpid = pid;
-	/* 
-	 * Remove mailbox corresponding to child with pid. Note
-         * this does not destroy the esn itself: proc_destroy does that
-	 */
-	struct esn_mailbox *cur;
-	struct esn_mailbox *prev;
-	/*
-	 * Need the current proc's lock in case another thread is altering
-	 * the mailbox node chain.
-	 */
-	spinlock_acquire(&curthread->t_proc->p_lock);
-	cur = curthread->t_proc->child_esn_mailbox;
-	/* Here and below, if a matching child_esn_mailbox node not found,
-	 * this pid must not be a child
-	 */
-	if(!cur) {
-		spinlock_release(&curthread->t_proc->p_lock);
-		return ECHILD;
+	/* no process groups, so the only negative pid we take is WAIT_ANY */
+	if(pid <= 0 && pid != WAIT_ANY) {
+		return EINVAL;
 	}
-	if(cur->child_pid == pid) {
-		curthread->t_proc->child_esn_mailbox = cur->next_mailbox;
-		kfree(cur);
+
+	spinlock_acquire(&proc->p_lock);
+	/* Make sure there's something to wait for before sleeping */
+	if(pid == WAIT_ANY) {
+		child_proc = NULL;
+		if(proc->p_children == NULL) {
+			spinlock_release(&proc->p_lock);
+			return ECHILD;
+		}
 	} else {
-		prev = cur;
-		cur = cur->next_mailbox;
-		while(cur && cur->child_pid != pid) {
-			prev = cur;
-			cur = cur->next_mailbox;
+		/*
+		 * PID might belong to anyone, and only the RCU read section
+		 * keeps an unrelated proc from being freed under us, so check
+		 * whose child it is before leaving it. Once we know it's one
+		 * of ours it stays valid: nobody but us reaps (or, on exit,
+		 * orphans) our children.
+		 */
+		rcu_read_lock();
+		child_proc = pid_table_find(pid);
+		if(child_proc == NULL) {
+			rcu_read_unlock();
+			spinlock_release(&proc->p_lock);
+			return ESRCH;
 		}
-		if(!cur) {
-			spinlock_release(&curthread->t_proc->p_lock);
+		if(child_proc->p_parent != proc || child_proc->p_sibprev == NULL) {
+			rcu_read_unlock();
+			spinlock_release(&proc->p_lock);
 			return ECHILD;
 		}
-		prev->next_mailbox = cur->next_mailbox;
-		kfree(cur);
+		rcu_read_unlock();
 	}
 
-	spinlock_release(&curthread->t_proc->p_lock);
+	/*
+	 * Exiting children queue themselves on p_zombies and wake
+	 * p_childwait, all under our p_lock, so checking and sleeping here
+	 * can't miss a wakeup.
+	 */
+	while((zombie = proc_take_zombie(proc, child_proc)) == NULL) {
+		if(options & WNOHANG) {
+			spinlock_release(&proc->p_lock);
+			*retpid = 0;
+			return 0;
+		}
+		wchan_sleep(proc->p_childwait, &proc->p_lock);
+	}
+	child_proc = zombie;
+	proc_remove_child(proc, child_proc);
+
+	/*
+	 * Charge the child's usage (and that of the children it reaped)
+	 * to us. The child detached its thread before queueing itself,
+	 * so its totals are final.
+	 */
+	threadusage_add(&proc->p_cusage, &child_proc->p_usage);
+	threadusage_add(&proc->p_cusage, &child_proc->p_cusage);
+	exitcode = child_proc->p_exit_status.exitcode;
+	*retpid = child_proc->pid;
+	spinlock_release(&proc->p_lock);
+
 	proc_destroy(child_proc);
+	copyout(&exitcode, status, sizeof(int));
 	return 0;
 }
 
 void sys__exit(int exitcode) {
 	struct proc *proc = curthread->t_proc;
 	/*
-	 * Set all child exit_status_needed's to 0 and free mailbox chain.
-	 * Child has continued access to needed while letting this process's
-	 * mailbox chain be freed.
+	 * Set all children's exit_status_needed to 0 and drop the list.
 	 *
 	 * Setting children needed flag to 0 is necessary here because parent
 	 * might not be proc_destroy()ed before child sys__exit()s and checks
-	 * its needed flag. Therefore, it must happen on parent exit. Freeing
-	 * the children mailboxes here makes sense because they are only needed
-	 * for the purpose of communicating to children that their exit status
-	 * is no longer needed.
+	 * its needed flag. Therefore, it must happen on parent exit.
 	 */
 
-	struct esn_mailbox *cur;	
-	struct esn_mailbox *prev;
-	/* cur sets exit_status_needed pointed to by current mailbox.
-	 * prev frees previous mailbox.
+	struct proc *child;
+	struct proc *next;
+	int zombie;
+	/* A child that has already exited is a zombie nobody will wait
+	 * for any more, so it goes on the reap queue; one that hasn't
+	 * will see needed == 0 and destroy itself. Either way it may be
+	 * gone once we let go of its esn_lock, so read its link first.
 	 */
 
-	cur = proc->child_esn_mailbox;
-	if(cur) {
-		spinlock_acquire(&cur->child_esn->esn_lock);
-		cur->child_esn->needed = 0;		
-		spinlock_release(&cur->child_esn->esn_lock);
-
-		prev = cur;
-		cur = cur->next_mailbox;
-		kfree(prev);
-
-		while(cur) {
-			spinlock_acquire(&cur->child_esn->esn_lock);
-			cur->child_esn->needed = 0;		
-			spinlock_release(&cur->child_esn->esn_lock);
-			
-			prev = cur; 
-			cur = cur->next_mailbox;
-			kfree(prev);
+	child = proc->p_children;
+	while(child) {
+		spinlock_acquire(&child->p_es_needed.esn_lock);
+		child->p_es_needed.needed = 0;		
+		child->p_parent = NULL;
+		zombie = child->p_es_needed.exited;
+		next = child->p_sibnext;
+		spinlock_release(&child->p_es_needed.esn_lock);
+		if(zombie) {
+			proc_orphan_zombie(child);
 		}
-		proc->child_esn_mailbox = NULL;
+		child = next;
 	}
+	proc->p_children = NULL;
+	proc->p_zombies = NULL;
+	proc->p_zombietail = &proc->p_zombies;
+
+	struct exit_status *es = &proc->p_exit_status;
+	es->exitcode = exitcode;
+	/* Ideally, we'd like this to happen in thread_exit, but
+	 * we need to ensure this occurs before a parent is signalled.
+	 * We don't want to context switch to the parent, who tries to
+	 * destroy us before our thread gets removed
+	 */
+	proc_remthread(curthread);
 
+	/*
+	 * Decide under esn_lock, together with the parent's exit, who
+	 * cleans up: if the parent still wants our status we become a
+	 * zombie (and once we let go of esn_lock must not touch proc,
+	 * since the parent may destroy it at any time; proc_destroy
+	 * defers the free past this cpu's next quiescent point); otherwise we
+	 * do it ourselves.
+	 */
 	spinlock_acquire(&proc->p_es_needed.esn_lock);
 	if(!(proc->p_es_needed.needed)) {
 		spinlock_release(&proc->p_es_needed.esn_lock);
-		proc_remthread(curthread);
 		proc_destroy(proc);
 	} else {
+		proc->p_es_needed.exited = 1;
+		spinlock_acquire(&proc->p_parent->p_lock);
+		proc_add_zombie(proc->p_parent, proc);
+		spinlock_release(&proc->p_parent->p_lock);
 		spinlock_release(&proc->p_es_needed.esn_lock);
-		struct exit_status *es = &proc->p_exit_status;
-		es->exitcode = exitcode;
-		/* Ideally, we'd like this to happen in thread_exit, but
-		 * we need to ensure this occurs before a parent is signalled.
-		 * We don't want to context switch to the parent, who tries to
-		 * destroy us before our thread gets removed
-		 */
-		proc_remthread(curthread);
-
-		V(es->exit_sem);
 	}
 
 	thread_exit();	
@@ -158,34 +190,9 @@ int sys_fork(struct trapframe *tf, int32_t *retpid) {
 	
 	*retpid = child_proc->pid;
 
-	/* add new mailbox and pointer to child p_es_needed */
-	struct esn_mailbox *cur_mailbox;
-	struct esn_mailbox *prev_mailbox = NULL;
+	/* link child onto our list; p_es_needed set to 1 in proc_create_fork() */
 	spinlock_acquire(&curthread->t_proc->p_lock);
-	cur_mailbox = curthread->t_proc->child_esn_mailbox;
-	
-	while(cur_mailbox) {
-		prev_mailbox = cur_mailbox;
-		cur_mailbox = cur_mailbox->next_mailbox;
-	}		
-	cur_mailbox = kmalloc(sizeof(struct esn_mailbox));
-	if(cur_mailbox == NULL) {
-		spinlock_release(&curthread->t_proc->p_lock);
-		kfree(child_proc);
-		return ENOMEM;
-	}
-	cur_mailbox->child_pid = child_proc->pid;
-	/* p_es_needed initialized to 1 in proc_create() */
-	cur_mailbox->child_esn = &child_proc->p_es_needed;
-	cur_mailbox->next_mailbox = NULL;	
-
-	/* case when there was existing mailbox at begin of this func execution */
-	if(prev_mailbox) {
-		prev_mailbox->next_mailbox = cur_mailbox;
-	} else {
-		curthread->t_proc->child_esn_mailbox = cur_mailbox;	
-	}
-
+	proc_add_child(curthread->t_proc, child_proc);
 	spinlock_release(&curthread->t_proc->p_lock);
 		
 	/* Copy tf to newly allocated tf to pass child. Needed to avoid
@@ -207,11 +214,23 @@ int sys_fork(struct trapframe *tf, int32_t *retpid) {
   	return 0;
 }
 
+/*
+ * execv stages its arguments in one arena, laid out exactly as they
+ * will sit at the top of the new user stack:
+ *
+ *     argv[0] ... argv[argc-1] NULL | strings, packed | padding
+ *
+ * While staging, each argv[i] holds its string's offset in the arena.
+ * Once the new address space exists, the offsets are turned into user
+ * addresses and the whole block goes out in one copyout, so there's
+ * no per-argument work after the strings are fetched. The program
+ * name is staged past the ARG_MAX part.
+ */
+#define EXECV_ARENA_SIZE (ARG_MAX + PATH_MAX)
+
 /*
  * Load program "progname" and start running it in usermode.
  * Does not return except on error.
- *
- * Calls vfs_open on progname and thus may destroy it.
  */
 int
 sys_execv(char *progname, char **argv) {
@@ -219,77 +238,63 @@ sys_execv(char *progname, char **argv) {
 	struct addrspace *as;
 	struct vnode *v;
 	vaddr_t entrypoint, stackptr;
-	int result = 0;
+	int result;
+	char *arena, *kprogname;
+	userptr_t *kargv;
+	size_t argc, used, total, actual, i;
 	
 	if(!(progname && argv)) {
 		return EFAULT;
 	}
 
-	char *argv_buf;
-	char **argvptr_buf;
-	argvptr_buf = kmalloc(sizeof(char*) * NUM_MAXARGS);
-	if(!argvptr_buf) {
-		return result;
-	}
-	argv_buf = kmalloc(sizeof(ARG_MAX));
-	if(!argv_buf) {
-		return result;
+	arena = kmalloc(EXECV_ARENA_SIZE);
+	if(!arena) {
+		return ENOMEM;
 	}
+	kargv = (userptr_t *)arena;
+	kprogname = arena + ARG_MAX;
 
-	int num_args = 0;
-	result = copyin((const_userptr_t)argv,
-			(void *) argvptr_buf, sizeof(userptr_t));
+	/* The pointers, all at once */
+	result = copyinptrs((const_userptr_t)argv, kargv,
+			    ARG_MAX / sizeof(userptr_t), &argc);
 	if(result) {
+		kfree(arena);
 		return result;
 	}
-	while(argvptr_buf[num_args]) {
-		num_args++;
-		result = copyin((const_userptr_t) (argv + num_args), 
-				(void *) (argvptr_buf + num_args), 
-				sizeof(userptr_t));
-		if(result) {
-			return result;
-		}					
-	}
-	/* Allocate space to track str lengths (they will all be in one array later) */
-	int *strlens = kmalloc(sizeof(int) * num_args);
-	if(!strlens) {
-		return ENOMEM;
-	}
 
-	size_t actual;
-	int i;
-	int bytescopied = 0;
-	for(i = 0; i < num_args; i++) {
-	
-		result = copyinstr((const_userptr_t)argvptr_buf[i], 
-				   (void *) (argv_buf + bytescopied), 
-				   ARG_MAX, &actual);
-		if(result) {
-			return result;
-		}
-		bytescopied += actual;
-		if(bytescopied > ARG_MAX) {
+	/* The strings, packed in right behind them */
+	used = (argc + 1) * sizeof(userptr_t);
+	for(i = 0; i < argc; i++) {
+		if(used == ARG_MAX) {
+			kfree(arena);
 			return E2BIG;
 		}
-		strlens[i] = actual;
+		result = copyinstr((const_userptr_t)kargv[i], arena + used,
+				   ARG_MAX - used, &actual);
+		if(result) {
+			kfree(arena);
+			return result == ENAMETOOLONG ? E2BIG : result;
+		}
+		kargv[i] = (userptr_t)used;
+		used += actual;
 	}
+	kargv[argc] = NULL;
+
+	/* Pad to keep the stack pointer aligned */
+	total = ROUNDUP(used, ALIGN_SIZE);
+	bzero(arena + used, total - used);
 
-	char *kprogname;
-	kprogname = (char *) kmalloc(sizeof(PATH_MAX));
-	if(!kprogname) {
-		return ENOMEM;
-	}
 	if((result = copyinstr((const_userptr_t)progname, 
 				kprogname, PATH_MAX, NULL))) {
+		kfree(arena);
 		return result;
 	}
 	
 	/* Open the file. */
 	result = vfs_open(kprogname, O_RDONLY, 0, &v);
 	if (result) {
+		kfree(arena);
 		return result;
-
 	}
 	/* This seems appropriate but revisit if as problems */
 	as_destroy(proc_getas());
@@ -297,6 +302,7 @@ sys_execv(char *progname, char **argv) {
 	as = as_create();
 	if (as == NULL) {
 		vfs_close(v);
+		kfree(arena);
 		return ENOMEM;
 	}
 
@@ -309,6 +315,7 @@ sys_execv(char *progname, char **argv) {
 	if (result) {
 		/* p_addrspace will go away when curproc is destroyed */
 		vfs_close(v);
+		kfree(arena);
 		return result;
 	}
 
@@ -319,44 +326,24 @@ sys_execv(char *progname, char **argv) {
 	result = as_define_stack(as, &stackptr);
 	if (result) {
 		/* p_addrspace will go away when curproc is destroyed */
+		kfree(arena);
 		return result;
 	}
+	as_setkinfo(as, curproc->pid, curproc->ppid);
 
-	/* Copy out arg strings to new user stack */
-	int bytesrem = bytescopied;
-	for(i = num_args - 1; i >= 0; i--) {
-		DEBUGASSERT(bytesrem >= 0);
-		stackptr -= strlens[i];	
-		result = copyoutstr((void *) &argv_buf[bytesrem - strlens[i]],
-				 (userptr_t) stackptr, strlens[i], NULL);
-		if(result) {
-			return result;
-		}
-		bytesrem -= strlens[i];
-		argvptr_buf[i] = (char *) stackptr;
-	}
-	DEBUGASSERT(bytesrem == 0);
-	/* Create padding to maintain alignment needed for stackptr. */
-	int totalbytes = bytescopied + sizeof(char *) * num_args;
-	int overrun; 
-	if((overrun = totalbytes % ALIGN_SIZE)) {
-		totalbytes += (ALIGN_SIZE - overrun); 
+	/* Relocate argv and copy the whole block onto the new stack */
+	stackptr -= total;
+	for(i = 0; i < argc; i++) {
+		kargv[i] = (userptr_t)(stackptr + (vaddr_t)kargv[i]);
 	}
-	stackptr -= totalbytes - bytescopied; 
-	
-	/* Make room on user stack and copyout argptrs to user address space */
-	result = copyout((void *) argvptr_buf, 
-			 (userptr_t) stackptr, sizeof(char *) * num_args);
+	result = copyout(arena, (userptr_t)stackptr, total);
+	kfree(arena);
 	if(result) {
 		return result;
 	}
-	
-	kfree(strlens);
-	kfree(argv_buf);
-	kfree(argvptr_buf);
 
 	/* Warp to user mode. */
-	enter_new_process(num_args /*argc*/, (userptr_t) stackptr /*userspace 
+	enter_new_process(argc /*argc*/, (userptr_t) stackptr /*userspace 
 			  addr of argv*/, NULL /*userspace addr of environment*/,
 			  stackptr, entrypoint);
 
@@ -366,8 +353,90 @@ sys_execv(char *progname, char **argv) {
 	return EINVAL;
 }
 
-int sys_printchar(const char *arg) {
-	kprintf(arg);
-  	return 0;
+/* Converts a count of hardclocks to a timeval */
+static void ticks_to_timeval(unsigned ticks, struct timeval *tv) {
+	tv->tv_sec = ticks / HZ;
+	tv->tv_usec = (ticks % HZ) * (1000000 / HZ);
+}
+
+/*
+ * Reports resource usage of the current process (RUSAGE_SELF) or of
+ * all of its children that have been waited for (RUSAGE_CHILDREN).
+ */
+int sys_getrusage(int who, userptr_t usage) {
+	struct proc *proc = curthread->t_proc;
+	struct threadusage tu;
+	struct rusage ru;
+
+	spinlock_acquire(&proc->p_lock);
+	if(who == RUSAGE_SELF) {
+		tu = proc->p_usage;
+		/* our own thread hasn't been folded into p_usage yet */
+		threadusage_add(&tu, &curthread->t_usage);
+	} else if(who == RUSAGE_CHILDREN) {
+		tu = proc->p_cusage;
+	} else {
+		spinlock_release(&proc->p_lock);
+		return EINVAL;
+	}
+	spinlock_release(&proc->p_lock);
+
+	bzero(&ru, sizeof(ru));
+	ticks_to_timeval(tu.tu_uticks, &ru.ru_utime);
+	ticks_to_timeval(tu.tu_sticks, &ru.ru_stime);
+	/* there is no paging to disk, so every fault is a minor fault */
+	ru.ru_minflt = tu.tu_nfaults;
+	ru.ru_nvcsw = tu.tu_nvcsw;
+	ru.ru_nivcsw = tu.tu_nivcsw;
+
+	return copyout(&ru, usage, sizeof(ru));
+}
+
+/*
+ * Gets/sets the scheduling priority of a process. Only PRIO_PROCESS is
+ * supported; who == 0 means the calling process.
+ */
+int sys_getpriority(int which, pid_t who, int32_t *retval) {
+	int prio, err;
+
+	if(which != PRIO_PROCESS) {
+		return EINVAL;
+	}
+	if(who == 0) {
+		who = curthread->t_proc->pid;
+	}
+	if((err = proc_getpriority(who, &prio))) {
+		return err;
+	}
+	*retval = prio;
+	return 0;
+}
+
+int sys_setpriority(int which, pid_t who, int prio) {
+	if(which != PRIO_PROCESS) {
+		return EINVAL;
+	}
+	if(who == 0) {
+		who = curthread->t_proc->pid;
+	}
+	return proc_setpriority(who, prio);
+}
+
+/*
+ * Prints a string from userspace on the console. It's copied in first
+ * and printed as data, never used as a format, so the user can't make
+ * kprintf read kernel memory. (Any format arguments are ignored.)
+ */
+#define PRINTCHAR_MAX 256
+
+int sys_printchar(const_userptr_t arg) {
+	char buf[PRINTCHAR_MAX];
+	int err;
+
+	if((err = copyinstr(arg, buf, sizeof(buf), NULL))) {
+		return err;
+	}
+	kprintf("%s", buf);
+	return 0;
 }
 
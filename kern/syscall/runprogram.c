@@ -147,6 +147,7 @@ runprogram_args(char *progname, int num_args, char **argv)
 		/* p_addrspace will go away when curproc is destroyed */
 		return result;
 	}
+	as_setkinfo(as, curproc->pid, curproc->ppid);
 
 	/* Copy out arg strings to new user stack */
 	int bytesrem = bytescopied;
@@ -241,6 +242,7 @@ runprogram(char *progname, int num_args, char **argv)
 		/* p_addrspace will go away when curproc is destroyed */
 		return result;
 	}
+	as_setkinfo(as, curproc->pid, curproc->ppid);
 
 	/* Warp to user mode. */
 	enter_new_process(0 /*argc*/, NULL /*userspace addr of argv*/,
@@ -0,0 +1,98 @@
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/sysring.h>
+#include <lib.h>
+#include <copyinout.h>
+#include <syscall.h>
+
+/*
+ * sysring_enter: run a batch of system calls queued in a ring in user
+ * memory, posting their results to a second ring (see kern/sysring.h).
+ * One trap then pays for the whole batch; each call still costs a
+ * copyin of its submission and a copyout of its completion.
+ *
+ * The head and tail indexes are read once on the way in and written
+ * back on the way out. Only the ones the kernel owns (sr_sqhead and
+ * sr_cqtail) are written, so userland may queue more submissions or
+ * consume completions meanwhile; they're picked up next time.
+ */
+int
+sys_sysring_enter(userptr_t uring, unsigned to_submit, int32_t *retval)
+{
+	struct sysring *ur = (struct sysring *)uring;
+	struct sysring ring;
+	struct sysring_sqe sqe;
+	struct sysring_cqe cqe;
+	unsigned mask, n;
+	int result, err;
+
+	result = copyin(uring, &ring, sizeof(ring));
+	if (result) {
+		return result;
+	}
+	if (ring.sr_entries == 0 || ring.sr_entries > SYSRING_MAXENTRIES ||
+	    (ring.sr_entries & (ring.sr_entries - 1)) != 0) {
+		return EINVAL;
+	}
+	if (ring.sr_sqtail - ring.sr_sqhead > ring.sr_entries ||
+	    ring.sr_cqtail - ring.sr_cqhead > ring.sr_entries) {
+		return EINVAL;
+	}
+	mask = ring.sr_entries - 1;
+
+	for (n = 0; n < to_submit; n++) {
+		if (ring.sr_sqhead == ring.sr_sqtail) {
+			/* nothing more queued */
+			break;
+		}
+		if (ring.sr_cqtail - ring.sr_cqhead == ring.sr_entries) {
+			/* no room for the result */
+			break;
+		}
+
+		result = copyin((const_userptr_t)
+				&ring.sr_sqes[ring.sr_sqhead & mask],
+				&sqe, sizeof(sqe));
+		if (result) {
+			break;
+		}
+
+		cqe.cqe_data = sqe.sqe_data;
+		err = syscall_batch(sqe.sqe_callno, sqe.sqe_args,
+				    &cqe.cqe_result);
+		if (err) {
+			cqe.cqe_result = -1;
+		}
+		cqe.cqe_errno = err;
+
+		/* It's been run, so it's consumed even if we can't post it */
+		ring.sr_sqhead++;
+		result = copyout(&cqe,
+				 (userptr_t)&ring.sr_cqes[ring.sr_cqtail & mask],
+				 sizeof(cqe));
+		if (result) {
+			n++;
+			break;
+		}
+		ring.sr_cqtail++;
+	}
+
+	/* Report a bad ring pointer only if nothing got run. */
+	if (result && n == 0) {
+		return result;
+	}
+
+	result = copyout((const void *)&ring.sr_sqhead,
+			 (userptr_t)&ur->sr_sqhead, sizeof(ring.sr_sqhead));
+	if (result) {
+		return result;
+	}
+	result = copyout((const void *)&ring.sr_cqtail,
+			 (userptr_t)&ur->sr_cqtail, sizeof(ring.sr_cqtail));
+	if (result) {
+		return result;
+	}
+
+	*retval = n;
+	return 0;
+}
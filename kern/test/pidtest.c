@@ -0,0 +1,101 @@
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <proc.h>
+#include <test.h>
+
+/*
+ * Pid table test: fill the table to exhaustion, free one pid and get
+ * another in its place, then free everything and fill it again.
+ *
+ * The processes are bare zeroed struct procs that only get a pid, so
+ * nothing else is created. Run it with no user programs going; they'd
+ * be competing for the same pids.
+ */
+
+static struct proc **pidtest_procs;
+
+/* Allocate pids until the table is full. Returns how many we got. */
+static
+unsigned
+pidtest_fill(void)
+{
+	struct proc *p;
+	unsigned n;
+	int result;
+
+	for (n = 0; n < PID_SLOTS; n++) {
+		p = kmalloc(sizeof(*p));
+		if (p == NULL) {
+			panic("pidtest: out of memory\n");
+		}
+		bzero(p, sizeof(*p));
+		result = new_pid(p);
+		if (result == ENPROC) {
+			kfree(p);
+			break;
+		}
+		if (result) {
+			panic("pidtest: new_pid: %s\n", strerror(result));
+		}
+		pidtest_procs[n] = p;
+	}
+	KASSERT(pid_table->size == PID_SLOTS);
+	return n;
+}
+
+static
+void
+pidtest_empty(unsigned n)
+{
+	unsigned i;
+
+	for (i = 0; i < n; i++) {
+		if (remove_pid(pidtest_procs[i]->pid)) {
+			panic("pidtest: remove_pid failed\n");
+		}
+		kfree(pidtest_procs[i]);
+	}
+}
+
+int
+pidtest(int nargs, char **args)
+{
+	struct proc extra;
+	unsigned n, n2;
+	pid_t oldpid;
+
+	(void)nargs; (void)args;
+
+	pidtest_procs = kmalloc(PID_SLOTS * sizeof(struct proc *));
+	if (pidtest_procs == NULL) {
+		return ENOMEM;
+	}
+
+	kprintf("pidtest: filling the pid table...\n");
+	n = pidtest_fill();
+	kprintf("pidtest: got %u pids\n", n);
+
+	/* Full: nothing more to be had. */
+	bzero(&extra, sizeof(extra));
+	KASSERT(new_pid(&extra) == ENPROC);
+
+	/* Free one; it must be reusable at once, under a new pid. */
+	oldpid = pidtest_procs[n/2]->pid;
+	KASSERT(remove_pid(oldpid) == 0);
+	KASSERT(new_pid(pidtest_procs[n/2]) == 0);
+	KASSERT(pidtest_procs[n/2]->pid != oldpid);
+	KASSERT(pidtest_procs[n/2]->pid % PID_SLOTS == oldpid % PID_SLOTS);
+	KASSERT(new_pid(&extra) == ENPROC);
+
+	kprintf("pidtest: freeing them all and filling again...\n");
+	pidtest_empty(n);
+	n2 = pidtest_fill();
+	KASSERT(n2 == n);
+	pidtest_empty(n2);
+
+	kfree(pidtest_procs);
+	pidtest_procs = NULL;
+	kprintf("pidtest: done.\n");
+	return 0;
+}
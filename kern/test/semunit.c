@@ -28,10 +28,12 @@
  */
 
 #include <types.h>
+#include <kern/errno.h>
 #include <lib.h>
 #include <spinlock.h>
 #include <synch.h>
 #include <thread.h>
+#include <wchan.h>
 #include <current.h>
 #include <clock.h>
 #include <test.h>
@@ -39,7 +41,7 @@
 /*
  * Unit tests for semaphores.
  *
- * We test 21 correctness criteria, each stated in a comment at the
+ * We test 24 correctness criteria, each stated in a comment at the
  * top of each test.
  *
  * Note that these tests go inside the semaphore abstraction to
@@ -818,3 +820,156 @@ semu22(int nargs, char **args)
 	panic("semu22: P tolerated null semaphore\n");
 	return 0;
 }
+
+/*
+ * Milliseconds elapsed since BEFORE.
+ */
+static
+unsigned
+ms_since(const struct timespec *before)
+{
+	struct timespec now, diff;
+
+	gettime(&now);
+	timespec_sub(&now, before, &diff);
+	return diff.tv_sec * 1000 + diff.tv_nsec / 1000000;
+}
+
+/*
+ * 23. Calling P_timeout on a semaphore with count == 0 and nobody
+ * calling V:
+ *    - returns ETIMEDOUT
+ *    - does not return before the deadline (give or take a tick)
+ *    - leaves sem_count at 0 and nobody on sem_wchan
+ *    - leaves no timeout pending
+ */
+int
+semu23(int nargs, char **args)
+{
+	struct semaphore *sem;
+	struct timespec before;
+	unsigned pending, elapsed;
+	int result;
+
+	(void)nargs; (void)args;
+
+	sem = makesem(0);
+	pending = timeout_npending();
+
+	gettime(&before);
+	result = P_timeout(sem, 500);
+	elapsed = ms_since(&before);
+
+	KASSERT(result == ETIMEDOUT);
+	KASSERT(elapsed + 1000 / HZ >= 500);
+	KASSERT(sem->sem_count == 0);
+	spinlock_acquire(&sem->sem_lock);
+	KASSERT(wchan_isempty(sem->sem_wchan, &sem->sem_lock));
+	spinlock_release(&sem->sem_lock);
+	KASSERT(timeout_npending() == pending);
+
+	ok();
+	sem_destroy(sem);
+	return 0;
+}
+
+/*
+ * 24. After calling P_timeout on a semaphore with count == 0 and
+ * another thread uses V once, well before the deadline:
+ *    - P_timeout returns 0, without waiting for the deadline
+ *    - sem_count is still 0
+ *    - the timeout is no longer pending
+ */
+
+static
+void
+semu24_sub(void *semv, unsigned long junk)
+{
+	struct semaphore *sem = semv;
+
+	(void)junk;
+
+	kprintf("semu24: waiting for parent to sleep\n");
+	clocksleep(1);
+	V(sem);
+}
+
+int
+semu24(int nargs, char **args)
+{
+	struct semaphore *sem;
+	struct timespec before;
+	unsigned pending, elapsed;
+	int result;
+
+	(void)nargs; (void)args;
+
+	sem = makesem(0);
+	pending = timeout_npending();
+
+	result = thread_fork("semu24_sub", NULL, semu24_sub, sem, 0);
+	if (result) {
+		panic("semu24: whoops: thread_fork failed\n");
+	}
+
+	gettime(&before);
+	result = P_timeout(sem, 30000);
+	elapsed = ms_since(&before);
+
+	KASSERT(result == 0);
+	KASSERT(elapsed < 30000);
+	KASSERT(sem->sem_count == 0);
+	KASSERT(timeout_npending() == pending);
+
+	ok();
+	sem_destroy(sem);
+	return 0;
+}
+
+/*
+ * 25. Calling V_n(N) on a semaphore with count == 0 and more than N
+ * threads waiting:
+ *    - wakes exactly N of them
+ *    - leaves sem_count at 0
+ * and calling V_n(N) with nobody waiting increases sem_count by N.
+ */
+int
+semu25(int nargs, char **args)
+{
+	struct semaphore *sem;
+	unsigned running;
+
+	(void)nargs; (void)args;
+
+	sem = makesem(0);
+	makewaiter(sem);
+	makewaiter(sem);
+	makewaiter(sem);
+
+	V_n(sem, 2);
+	kprintf("Sleeping for woken waiters to finish\n");
+	clocksleep(1);
+
+	spinlock_acquire(&waiters_lock);
+	running = waiters_running;
+	spinlock_release(&waiters_lock);
+	KASSERT(running == 1);
+	KASSERT(sem->sem_count == 0);
+	spinlock_acquire(&sem->sem_lock);
+	KASSERT(!wchan_isempty(sem->sem_wchan, &sem->sem_lock));
+	spinlock_release(&sem->sem_lock);
+
+	/* Let the last waiter go. */
+	V(sem);
+	clocksleep(1);
+	spinlock_acquire(&waiters_lock);
+	KASSERT(waiters_running == 0);
+	spinlock_release(&waiters_lock);
+
+	V_n(sem, 3);
+	KASSERT(sem->sem_count == 3);
+
+	ok();
+	sem_destroy(sem);
+	return 0;
+}
@@ -33,7 +33,12 @@
 #include <wchan.h>
 #include <clock.h>
 #include <thread.h>
+#include <proc.h>
 #include <current.h>
+#include <rcu.h>
+#include <membar.h>
+#include <vm.h>
+#include <kern/kinfo.h>
 
 /*
  * Time handling.
@@ -52,6 +57,7 @@
  */
 #define SCHEDULE_HARDCLOCKS	4	/* Reschedule every 4 hardclocks. */
 #define MIGRATE_HARDCLOCKS	16	/* Migrate every 16 hardclocks. */
+#define QUANTUM_HARDCLOCKS	4	/* Time slice is 4 hardclocks. */
 
 /*
  * Once a second, everything waiting on lbolt is awakened by CPU 0.
@@ -59,12 +65,33 @@
 static struct wchan *lbolt;
 static struct spinlock lbolt_lock;
 
+/*
+ * Pending timeouts, sorted by expiry, and the tick count they are
+ * measured against; both only advanced on cpu 0.
+ */
+#define TICK_BEFORE(a, b) ((int)((a) - (b)) < 0)
+
+static struct timeout *timeout_list;
+static unsigned timeout_ticks;
+static struct spinlock timeout_lock;
+
+/*
+ * The clock page user programs read the time from; only cpu 0
+ * writes it.
+ */
+static struct kinfo_clock *kinfo_clock;
+static paddr_t kinfo_clockpaddr;
+
 /*
  * Setup.
  */
 void
 hardclock_bootstrap(void)
 {
+	spinlock_init(&timeout_lock);
+	timeout_list = NULL;
+	timeout_ticks = 0;
+
 	spinlock_init(&lbolt_lock);
 	lbolt = wchan_create("lbolt");
 	if (lbolt == NULL) {
@@ -72,6 +99,50 @@ hardclock_bootstrap(void)
 	}
 }
 
+/*
+ * Set up the kinfo clock page. Must come after vm_bootstrap (to get
+ * a page) and after the clock device has attached (for gettime).
+ */
+void
+kinfo_bootstrap(void)
+{
+	vaddr_t page;
+
+	page = alloc_kpages(1);
+	if (page == 0) {
+		panic("Couldn't allocate kinfo clock page\n");
+	}
+	bzero((void *)page, PAGE_SIZE);
+	kinfo_clockpaddr = KVADDR_TO_PADDR(page);
+	membar_store_store();
+	kinfo_clock = (struct kinfo_clock *)page;
+}
+
+paddr_t
+kinfo_clockpage(void)
+{
+	return kinfo_clockpaddr;
+}
+
+/*
+ * Refresh the kinfo clock page. Bump the sequence number around the
+ * update so readers can tell they raced with it.
+ */
+static
+void
+kinfo_tick(void)
+{
+	struct timespec ts;
+
+	gettime(&ts);
+	kinfo_clock->kc_seq++;
+	membar_store_store();
+	kinfo_clock->kc_sec = ts.tv_sec;
+	kinfo_clock->kc_nsec = ts.tv_nsec;
+	membar_store_store();
+	kinfo_clock->kc_seq++;
+}
+
 /*
  * This is called once per second, on one processor, by the timer
  * code.
@@ -85,6 +156,110 @@ timerclock(void)
 	spinlock_release(&lbolt_lock);
 }
 
+void
+timeout_init(struct timeout *to)
+{
+	to->to_next = NULL;
+	to->to_expire = 0;
+	to->to_state = TO_IDLE;
+	to->to_func = NULL;
+	to->to_data = NULL;
+}
+
+void
+timeout_add(struct timeout *to, unsigned ticks,
+	    void (*func)(void *), void *data)
+{
+	struct timeout **pp;
+
+	if (ticks == 0) {
+		ticks = 1;
+	}
+
+	spinlock_acquire(&timeout_lock);
+	KASSERT(to->to_state == TO_IDLE);
+	to->to_func = func;
+	to->to_data = data;
+	to->to_expire = timeout_ticks + ticks;
+	for (pp = &timeout_list; *pp != NULL; pp = &(*pp)->to_next) {
+		if (TICK_BEFORE(to->to_expire, (*pp)->to_expire)) {
+			break;
+		}
+	}
+	to->to_next = *pp;
+	*pp = to;
+	to->to_state = TO_PENDING;
+	spinlock_release(&timeout_lock);
+}
+
+bool
+timeout_cancel(struct timeout *to)
+{
+	struct timeout **pp;
+
+	spinlock_acquire(&timeout_lock);
+	if (to->to_state == TO_PENDING) {
+		for (pp = &timeout_list; *pp != to; pp = &(*pp)->to_next) {
+			KASSERT(*pp != NULL);
+		}
+		*pp = to->to_next;
+		to->to_next = NULL;
+		to->to_state = TO_IDLE;
+		spinlock_release(&timeout_lock);
+		return true;
+	}
+	while (to->to_state == TO_FIRING) {
+		/* Let cpu 0 finish running it. */
+		spinlock_release(&timeout_lock);
+		spinlock_acquire(&timeout_lock);
+	}
+	spinlock_release(&timeout_lock);
+	return false;
+}
+
+unsigned
+timeout_npending(void)
+{
+	struct timeout *to;
+	unsigned n = 0;
+
+	spinlock_acquire(&timeout_lock);
+	for (to = timeout_list; to != NULL; to = to->to_next) {
+		n++;
+	}
+	spinlock_release(&timeout_lock);
+	return n;
+}
+
+/*
+ * Advance the timeout clock one tick and fire whatever has come due.
+ * Each function is called with timeout_lock dropped, so it may take
+ * other spinlocks (and so that timeout_add can be called under them).
+ */
+static
+void
+timeout_tick(void)
+{
+	struct timeout *to;
+
+	spinlock_acquire(&timeout_lock);
+	timeout_ticks++;
+	while (timeout_list != NULL &&
+	       !TICK_BEFORE(timeout_ticks, timeout_list->to_expire)) {
+		to = timeout_list;
+		timeout_list = to->to_next;
+		to->to_next = NULL;
+		to->to_state = TO_FIRING;
+		spinlock_release(&timeout_lock);
+
+		to->to_func(to->to_data);
+
+		spinlock_acquire(&timeout_lock);
+		to->to_state = TO_IDLE;
+	}
+	spinlock_release(&timeout_lock);
+}
+
 /*
  * This is called HZ times a second (on each processor) by the timer
  * code.
@@ -97,13 +272,53 @@ hardclock(void)
 	 */
 
 	curcpu->c_hardclocks++;
+
+	if (curcpu->c_number == 0) {
+		timeout_tick();
+		if (kinfo_clock != NULL) {
+			kinfo_tick();
+		}
+	}
+
+	/*
+	 * If the cpu is idle there is nothing running to preempt and
+	 * nothing queued to migrate or reshuffle; skip the tick. (The
+	 * idle loop will notice new work on its own when it is woken
+	 * by the IPI that posted it.)
+	 */
+	if (curcpu->c_isidle) {
+		return;
+	}
+
+	/* Charge the tick to whoever was running. */
+	if (curthread->t_intr_user) {
+		curthread->t_usage.tu_uticks++;
+		rcu_quiescent();
+	}
+	else {
+		curthread->t_usage.tu_sticks++;
+	}
+	curthread->t_pass += thread_stride(curthread);
+
 	if ((curcpu->c_hardclocks % MIGRATE_HARDCLOCKS) == 0) {
 		thread_consider_migration();
 	}
 	if ((curcpu->c_hardclocks % SCHEDULE_HARDCLOCKS) == 0) {
 		schedule();
 	}
-	thread_yield();
+
+	/*
+	 * Preempt the current thread only once its time slice has run
+	 * out, and only if something else is waiting to run. Peeking
+	 * at the run queue without the lock is fine; thread_switch
+	 * checks again properly. If nothing else is runnable, the
+	 * thread keeps the cpu and we check again on the next tick.
+	 */
+	if (curcpu->c_hardclocks - curthread->t_slicestart
+	    >= QUANTUM_HARDCLOCKS &&
+	    !threadlist_isempty(&curcpu->c_runqueue)) {
+		thread_yield();
+	}
 }
 
 /*
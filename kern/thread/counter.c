@@ -0,0 +1,108 @@
+#include <types.h>
+#include <lib.h>
+#include <spl.h>
+#include <spinlock.h>
+#include <membar.h>
+#include <cpu.h>
+#include <current.h>
+#include <counter.h>
+
+/*
+ * Per-cpu event counters. See counter.h.
+ */
+
+/* List of every counter that has a slot. Append-only. */
+static struct counter *volatile counter_list = NULL;
+static struct counter **counter_tail = (struct counter **)&counter_list;
+static unsigned counter_nextslot = 1;
+static struct spinlock counter_listlock = SPINLOCK_INITIALIZER;
+
+/*
+ * Give CTR a slot the first time it's used. New counters go on the
+ * tail of the list (so the dump comes out in order of first use), and
+ * the slot is only published once it's on the list, so the dump can
+ * walk the list without the lock.
+ */
+static
+void
+counter_attach(struct counter *ctr)
+{
+	spinlock_acquire(&counter_listlock);
+	if (ctr->ctr_slot == 0) {
+		if (counter_nextslot == COUNTER_SLOTS) {
+			panic("counter: out of slots for %s\n", ctr->ctr_name);
+		}
+		ctr->ctr_next = NULL;
+		membar_store_store();
+		*counter_tail = ctr;
+		counter_tail = &ctr->ctr_next;
+		membar_store_store();
+		ctr->ctr_slot = counter_nextslot++;
+	}
+	spinlock_release(&counter_listlock);
+}
+
+void
+counter_add(struct counter *ctr, unsigned n)
+{
+	int spl;
+
+	if (!CURCPU_EXISTS()) {
+		return;
+	}
+	if (ctr->ctr_slot == 0) {
+		counter_attach(ctr);
+	}
+
+	/*
+	 * Interrupts off so we can't migrate in the middle. A 64-bit
+	 * add is two stores on a 32-bit cpu, so bracket it with the
+	 * sequence number for readers on other cpus.
+	 */
+	spl = splhigh();
+	curcpu->c_counters_seq++;
+	membar_store_store();
+	curcpu->c_counters[ctr->ctr_slot] += n;
+	membar_store_store();
+	curcpu->c_counters_seq++;
+	splx(spl);
+}
+
+/*
+ * Sum over all cpus, since the last reset. Increments in progress on
+ * other cpus may or may not be included.
+ */
+uint64_t
+counter_read(struct counter *ctr)
+{
+	if (ctr->ctr_slot == 0) {
+		return 0;
+	}
+	return cpu_counter_sum(ctr->ctr_slot) - ctr->ctr_base;
+}
+
+void
+counter_print(void)
+{
+	struct counter *ctr;
+
+	kprintf("%-24s %20s\n", "counter", "count");
+	for (ctr = counter_list; ctr != NULL; ctr = ctr->ctr_next) {
+		kprintf("%-24s %20llu\n", ctr->ctr_name,
+			(unsigned long long)counter_read(ctr));
+	}
+}
+
+/*
+ * Zero all counters. The per-cpu slots belong to their cpus, so
+ * instead of clearing them we remember where each sum stands now.
+ */
+void
+counter_reset(void)
+{
+	struct counter *ctr;
+
+	for (ctr = counter_list; ctr != NULL; ctr = ctr->ctr_next) {
+		ctr->ctr_base = cpu_counter_sum(ctr->ctr_slot);
+	}
+}
@@ -0,0 +1,157 @@
+#include <types.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <membar.h>
+#include <clock.h>
+#include <lockstat.h>
+
+/*
+ * Lock contention statistics. See lockstat.h.
+ */
+
+/* Off at boot; the clock isn't attached until mainbus_bootstrap. */
+static volatile bool lockstat_enabled = false;
+
+/* List of every lockstat acquired while enabled. Append-only. */
+static struct lockstat *volatile lockstat_list = NULL;
+static struct spinlock lockstat_listlock = SPINLOCK_INITIALIZER;
+
+void
+lockstat_init(struct lockstat *ls, const char *name)
+{
+	bzero(ls, sizeof(*ls));
+	snprintf(ls->ls_name, sizeof(ls->ls_name), "%s", name);
+}
+
+/*
+ * Put LS on the list the first time it's seen. The list is only ever
+ * added to at the head, so the dump can walk it without the lock.
+ */
+static
+void
+lockstat_list_add(struct lockstat *ls)
+{
+	spinlock_acquire(&lockstat_listlock);
+	if (!ls->ls_listed) {
+		ls->ls_next = lockstat_list;
+		membar_store_store();
+		lockstat_list = ls;
+		ls->ls_listed = true;
+	}
+	spinlock_release(&lockstat_listlock);
+}
+
+static
+void
+lockstat_count(struct lockstat *ls, bool contended, unsigned spins)
+{
+	if (!ls->ls_listed) {
+		lockstat_list_add(ls);
+	}
+	ls->ls_acquires++;
+	if (contended) {
+		ls->ls_contended++;
+	}
+	ls->ls_spins += spins;
+}
+
+void
+lockstat_acquired(struct lockstat *ls, bool contended, unsigned spins)
+{
+	if (!lockstat_enabled) {
+		return;
+	}
+	lockstat_count(ls, contended, spins);
+	gettime(&ls->ls_acqtime);
+	ls->ls_timing = true;
+}
+
+void
+lockstat_acquired_shared(struct lockstat *ls, bool contended)
+{
+	if (!lockstat_enabled) {
+		return;
+	}
+	lockstat_count(ls, contended, 0);
+}
+
+void
+lockstat_released(struct lockstat *ls)
+{
+	struct timespec now, held;
+	uint32_t ns;
+
+	if (!ls->ls_timing) {
+		/* acquired while collection was off */
+		return;
+	}
+	ls->ls_timing = false;
+
+	gettime(&now);
+	timespec_sub(&now, &ls->ls_acqtime, &held);
+	/* Saturate anything over ~4 seconds. */
+	if (held.tv_sec >= 4) {
+		ns = 0xffffffff;
+	}
+	else {
+		ns = held.tv_sec * 1000000000U + held.tv_nsec;
+	}
+	ls->ls_holds++;
+	ls->ls_holdns += ns;
+	if (ns > ls->ls_maxholdns) {
+		ls->ls_maxholdns = ns;
+	}
+}
+
+/*
+ * Turn collection on or off.
+ */
+void
+lockstat_enable(bool on)
+{
+	lockstat_enabled = on;
+}
+
+/*
+ * Print the statistics for every lock seen so far. The counters are
+ * read without holding the locks in question, so a lock that's busy
+ * right now may show slightly inconsistent numbers.
+ */
+void
+lockstat_print(void)
+{
+	struct lockstat *ls;
+	uint64_t avgns;
+
+	kprintf("Lock statistics are %s (hold times in ns)\n",
+		lockstat_enabled ? "on" : "off");
+	kprintf("%-24s %10s %10s %12s %10s %10s\n", "lock", "acquires",
+		"contended", "spins", "hold avg", "hold max");
+
+	for (ls = lockstat_list; ls != NULL; ls = ls->ls_next) {
+		avgns = ls->ls_holds ? ls->ls_holdns / ls->ls_holds : 0;
+		kprintf("%-24s %10u %10u %12llu %10llu %10u\n", ls->ls_name,
+			ls->ls_acquires, ls->ls_contended,
+			(unsigned long long)ls->ls_spins,
+			(unsigned long long)avgns, ls->ls_maxholdns);
+	}
+}
+
+/*
+ * Zero the counters of every lock seen so far. Like printing, this is
+ * done without the locks and can race with an acquisition in progress.
+ */
+void
+lockstat_reset(void)
+{
+	struct lockstat *ls;
+
+	for (ls = lockstat_list; ls != NULL; ls = ls->ls_next) {
+		ls->ls_acquires = 0;
+		ls->ls_contended = 0;
+		ls->ls_spins = 0;
+		ls->ls_holds = 0;
+		ls->ls_holdns = 0;
+		ls->ls_maxholdns = 0;
+	}
+}
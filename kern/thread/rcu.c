@@ -0,0 +1,107 @@
+#include <types.h>
+#include <lib.h>
+#include <spl.h>
+#include <spinlock.h>
+#include <cpu.h>
+#include <current.h>
+#include <rcu.h>
+
+/*
+ * Read-copy-update. See rcu.h.
+ *
+ * Each call_rcu starts a new generation, and a callback may run once
+ * every cpu has recorded (in c_rcu_seen) a generation at least that
+ * new at a quiescent point. Pending callbacks are kept in call order,
+ * which is also generation order.
+ */
+
+#define GEN_BEFORE(a, b) ((int)((a) - (b)) < 0)
+
+static volatile unsigned rcu_gen = 0;
+static struct rcu_head *rcu_head = NULL, **rcu_tail = &rcu_head;
+static struct spinlock rcu_spinlock = SPINLOCK_INITIALIZER;
+
+void
+rcu_read_lock(void)
+{
+	splraise(IPL_NONE, IPL_HIGH);
+}
+
+void
+rcu_read_unlock(void)
+{
+	spllower(IPL_HIGH, IPL_NONE);
+}
+
+/*
+ * Call with interrupts off.
+ */
+void
+rcu_quiescent(void)
+{
+	curcpu->c_rcu_seen = rcu_gen;
+}
+
+/*
+ * Run the callbacks whose grace period is over.
+ */
+void
+rcu_reclaim(void)
+{
+	struct rcu_head *done, **donetail, *rh;
+	unsigned seen;
+	int spl;
+
+	if (rcu_head == NULL) {
+		return;
+	}
+
+	/*
+	 * We're not in a read section, so this cpu is quiescent now.
+	 * (Interrupts off so we can't be moved to another cpu midway.)
+	 */
+	spl = splhigh();
+	rcu_quiescent();
+	splx(spl);
+	seen = cpu_rcu_seen();
+
+	spinlock_acquire(&rcu_spinlock);
+	done = rcu_head;
+	donetail = &rcu_head;
+	while (*donetail != NULL && !GEN_BEFORE(seen, (*donetail)->rh_gen)) {
+		donetail = &(*donetail)->rh_next;
+	}
+	if (donetail == &rcu_head) {
+		spinlock_release(&rcu_spinlock);
+		return;
+	}
+	rcu_head = *donetail;
+	if (rcu_head == NULL) {
+		rcu_tail = &rcu_head;
+	}
+	*donetail = NULL;
+	spinlock_release(&rcu_spinlock);
+
+	while (done != NULL) {
+		rh = done;
+		done = rh->rh_next;
+		rh->rh_func(rh->rh_data);
+	}
+}
+
+void
+call_rcu(struct rcu_head *rh, void (*func)(void *), void *data)
+{
+	rh->rh_next = NULL;
+	rh->rh_func = func;
+	rh->rh_data = data;
+
+	spinlock_acquire(&rcu_spinlock);
+	/* The spinlock orders the caller's unlink before the new gen. */
+	rh->rh_gen = ++rcu_gen;
+	*rcu_tail = rh;
+	rcu_tail = &rh->rh_next;
+	spinlock_release(&rcu_spinlock);
+
+	rcu_reclaim();
+}
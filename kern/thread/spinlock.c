@@ -37,6 +37,7 @@
 #include <spl.h>
 #include <spinlock.h>
 #include <membar.h>
+#include <lockstat.h>
 #include <current.h>	/* for curcpu */
 
 /*
@@ -52,6 +53,20 @@ spinlock_init(struct spinlock *splk)
 {
 	spinlock_data_set(&splk->splk_lock, 0);
 	splk->splk_holder = NULL;
+	splk->splk_stat = NULL;
+	spinlock_data_set(&splk->splk_next, 0);
+	spinlock_data_set(&splk->splk_serving, 0);
+	splk->splk_ticket = false;
+}
+
+/*
+ * Initialize a ticket spinlock.
+ */
+void
+spinlock_init_ticket(struct spinlock *splk)
+{
+	spinlock_init(splk);
+	splk->splk_ticket = true;
 }
 
 /*
@@ -62,6 +77,8 @@ spinlock_cleanup(struct spinlock *splk)
 {
 	KASSERT(splk->splk_holder == NULL);
 	KASSERT(spinlock_data_get(&splk->splk_lock) == 0);
+	KASSERT(spinlock_data_get(&splk->splk_next) ==
+		spinlock_data_get(&splk->splk_serving));
 }
 
 /*
@@ -75,6 +92,8 @@ void
 spinlock_acquire(struct spinlock *splk)
 {
 	struct cpu *mycpu;
+	spinlock_data_t ticket;
+	unsigned spins = 0;
 
 	splraise(IPL_NONE, IPL_HIGH);
 
@@ -90,28 +109,47 @@ spinlock_acquire(struct spinlock *splk)
 		mycpu = NULL;
 	}
 
-	while (1) {
+	if (splk->splk_ticket) {
 		/*
-		 * Do test-test-and-set, that is, read first before
-		 * doing test-and-set, to reduce bus contention.
-		 *
-		 * Test-and-set is a machine-level atomic operation
-		 * that writes 1 into the lock word and returns the
-		 * previous value. If that value was 0, the lock was
-		 * previously unheld and we now own it. If it was 1,
-		 * we don't.
+		 * Take a number and wait for it to come up. Only the
+		 * holder ever changes splk_serving, so the waiters
+		 * just read it.
 		 */
-		if (spinlock_data_get(&splk->splk_lock) != 0) {
-			continue;
+		ticket = spinlock_data_fetchadd(&splk->splk_next, 1);
+		while (spinlock_data_get(&splk->splk_serving) != ticket) {
+			spins++;
 		}
-		if (spinlock_data_testandset(&splk->splk_lock) != 0) {
-			continue;
+	}
+	else {
+		while (1) {
+			/*
+			 * Do test-test-and-set, that is, read first before
+			 * doing test-and-set, to reduce bus contention.
+			 *
+			 * Test-and-set is a machine-level atomic operation
+			 * that writes 1 into the lock word and returns the
+			 * previous value. If that value was 0, the lock was
+			 * previously unheld and we now own it. If it was 1,
+			 * we don't.
+			 */
+			if (spinlock_data_get(&splk->splk_lock) != 0) {
+				spins++;
+				continue;
+			}
+			if (spinlock_data_testandset(&splk->splk_lock) != 0) {
+				spins++;
+				continue;
+			}
+			break;
 		}
-		break;
 	}
 
 	membar_store_any();
 	splk->splk_holder = mycpu;
+
+	if (splk->splk_stat != NULL) {
+		lockstat_acquired(splk->splk_stat, spins > 0, spins);
+	}
 }
 
 /*
@@ -120,6 +158,8 @@ spinlock_acquire(struct spinlock *splk)
 void
 spinlock_release(struct spinlock *splk)
 {
+	spinlock_data_t ticket;
+
 	/* this must work before curcpu initialization */
 	if (CURCPU_EXISTS()) {
 		KASSERT(splk->splk_holder == curcpu->c_self);
@@ -127,9 +167,21 @@ spinlock_release(struct spinlock *splk)
 		curcpu->c_spinlocks--;
 	}
 
+	if (splk->splk_stat != NULL) {
+		lockstat_released(splk->splk_stat);
+	}
+
 	splk->splk_holder = NULL;
-	membar_any_store();
-	spinlock_data_set(&splk->splk_lock, 0);
+	if (splk->splk_ticket) {
+		/* Serve the next ticket. */
+		ticket = spinlock_data_get(&splk->splk_serving);
+		membar_any_store();
+		spinlock_data_set(&splk->splk_serving, ticket + 1);
+	}
+	else {
+		membar_any_store();
+		spinlock_data_set(&splk->splk_lock, 0);
+	}
 	spllower(IPL_HIGH, IPL_NONE);
 }
 
@@ -146,3 +198,12 @@ spinlock_do_i_hold(struct spinlock *splk)
 	/* Assume we can read splk_holder atomically enough for this to work */
 	return (splk->splk_holder == curcpu->c_self);
 }
+
+/*
+ * Keep contention statistics for the lock.
+ */
+void
+spinlock_setstat(struct spinlock *splk, struct lockstat *ls)
+{
+	splk->splk_stat = ls;
+}
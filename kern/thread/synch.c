@@ -33,8 +33,13 @@
  */
 
 #include <types.h>
+#include <kern/errno.h>
 #include <lib.h>
+#include <cpu.h>
+#include <clock.h>
+#include <membar.h>
 #include <spinlock.h>
+#include <lockstat.h>
 #include <wchan.h>
 #include <thread.h>
 #include <current.h>
@@ -134,10 +139,92 @@ V(struct semaphore *sem)
 	spinlock_release(&sem->sem_lock);
 }
 
+/*
+ * A thread sleeping in P_timeout, for the timeout function to find.
+ */
+struct sem_timedwait {
+	struct semaphore *st_sem;
+	struct thread *st_thread;
+	bool st_expired;
+};
+
+static
+void
+sem_timedout(void *data)
+{
+	struct sem_timedwait *st = data;
+	struct semaphore *sem = st->st_sem;
+
+	spinlock_acquire(&sem->sem_lock);
+	st->st_expired = true;
+	wchan_wakethread(sem->sem_wchan, &sem->sem_lock, st->st_thread);
+	spinlock_release(&sem->sem_lock);
+}
+
+int
+P_timeout(struct semaphore *sem, unsigned ms)
+{
+	struct sem_timedwait st;
+	struct timeout to;
+	bool armed = false;
+	int result;
+
+        KASSERT(sem != NULL);
+        KASSERT(curthread->t_in_interrupt == false);
+
+	st.st_sem = sem;
+	st.st_thread = curthread;
+	st.st_expired = false;
+	timeout_init(&to);
+
+	spinlock_acquire(&sem->sem_lock);
+	while (sem->sem_count == 0 && ms > 0 && !st.st_expired) {
+		if (!armed) {
+			timeout_add(&to, MS_TO_TICKS(ms), sem_timedout, &st);
+			armed = true;
+		}
+		wchan_sleep(sem->sem_wchan, &sem->sem_lock);
+	}
+	if (sem->sem_count > 0) {
+		sem->sem_count--;
+		result = 0;
+	}
+	else {
+		result = ETIMEDOUT;
+	}
+	spinlock_release(&sem->sem_lock);
+
+	/* sem_timedout takes sem_lock, so this must come after. */
+	if (armed) {
+		timeout_cancel(&to);
+	}
+	return result;
+}
+
+void
+V_n(struct semaphore *sem, unsigned n)
+{
+        KASSERT(sem != NULL);
+
+	spinlock_acquire(&sem->sem_lock);
+
+        sem->sem_count += n;
+        KASSERT(sem->sem_count >= n);
+	wchan_waken(sem->sem_wchan, n, &sem->sem_lock);
+
+	spinlock_release(&sem->sem_lock);
+}
+
 ////////////////////////////////////////////////////////////
 //
 // Lock.
 
+/*
+ * Number of times lock_acquire polls a held lock, while its holder is
+ * running on another cpu, before giving up and going to sleep.
+ */
+#define LOCK_SPIN_MAX 1000
+
 struct lock *
 lock_create(const char *name)
 {
@@ -154,7 +241,20 @@ lock_create(const char *name)
                 return NULL;
         }
 
-        // add stuff here as needed
+	lock->lk_wchan = wchan_create(lock->lk_name);
+	if (lock->lk_wchan == NULL) {
+		kfree(lock->lk_name);
+		kfree(lock);
+		return NULL;
+	}
+
+	spinlock_init(&lock->lk_spinlock);
+	spinlock_data_set(&lock->lk_locked, 0);
+	lock->lk_holder = NULL;
+	lock->lk_waiters = 0;
+	lock->lk_stat = NULL;
+	lock->lk_donation = 0;
+	lock->lk_nextheld = NULL;
 
         return lock;
 }
@@ -163,37 +263,305 @@ void
 lock_destroy(struct lock *lock)
 {
         KASSERT(lock != NULL);
+	KASSERT(lock->lk_holder == NULL);
+	KASSERT(lock->lk_waiters == 0);
 
-        // add stuff here as needed
+	/* wchan_cleanup will assert if anyone's waiting on it */
+	spinlock_cleanup(&lock->lk_spinlock);
+	wchan_destroy(lock->lk_wchan);
 
         kfree(lock->lk_name);
         kfree(lock);
 }
 
+/*
+ * Priority inheritance.
+ *
+ * A thread about to sleep on a lock lends its stride (see
+ * thread_stride) to the holder, if that's a higher priority than the
+ * holder has; and if the holder is itself asleep on a lock, on to that
+ * lock's holder, and so on down the chain. Each lock remembers in
+ * lk_donation the best stride lent through it since it was last free
+ * of waiters, and a thread's t_inherit is the best lk_donation among
+ * the locks on its t_heldlocks list, recomputed when it releases one.
+ * (So a holder may keep a loan a little longer than the waiter that
+ * made it sticks around; that's harmless.)
+ *
+ * t_inherit, t_blockedon, and lk_donation are protected by
+ * lock_pi_spinlock, which nests inside lk_spinlock. Walking the chain
+ * looks at threads whose locks we don't have. They can't go away
+ * under us: the holder of a lock with waiters passes through
+ * lock_pi_spinlock in lock_release, after clearing lk_holder, and a
+ * waiter leaves t_blockedon set until it is no longer in lk_waiters.
+ *
+ * LOCK_PI_MAXDEPTH bounds the chain walk.
+ */
+#define LOCK_PI_MAXDEPTH 8
+
+static struct spinlock lock_pi_spinlock = SPINLOCK_INITIALIZER;
+
+/*
+ * Lend STRIDE through LOCK.
+ */
+static
+void
+lock_lend(struct lock *lock, unsigned stride)
+{
+	struct thread *holder;
+	unsigned depth;
+
+	KASSERT(spinlock_do_i_hold(&lock_pi_spinlock));
+
+	for (depth = 0; lock != NULL && depth < LOCK_PI_MAXDEPTH; depth++) {
+		if (lock->lk_donation == 0 || stride < lock->lk_donation) {
+			lock->lk_donation = stride;
+		}
+		holder = lock->lk_holder;
+		if (holder == NULL || thread_stride(holder) <= stride) {
+			break;
+		}
+		holder->t_inherit = stride;
+		thread_boost(holder);
+		lock = holder->t_blockedon;
+	}
+}
+
+/*
+ * Best stride lent to T through the locks it holds, or 0.
+ */
+static
+unsigned
+lock_inherited(struct thread *t)
+{
+	struct lock *lock;
+	unsigned stride;
+
+	KASSERT(spinlock_do_i_hold(&lock_pi_spinlock));
+
+	stride = 0;
+	for (lock = t->t_heldlocks; lock != NULL; lock = lock->lk_nextheld) {
+		if (lock->lk_donation != 0 &&
+		    (stride == 0 || lock->lk_donation < stride)) {
+			stride = lock->lk_donation;
+		}
+	}
+	return stride;
+}
+
+/*
+ * Bookkeeping for a successful acquire: put the lock on our held list,
+ * pick up any loan already made through it, and record lockstat.
+ */
+static
+void
+lock_acquired(struct lock *lock, bool contended, unsigned spins)
+{
+	struct thread *cur = curthread;
+
+	lock->lk_nextheld = cur->t_heldlocks;
+	cur->t_heldlocks = lock;
+
+	if (lock->lk_donation != 0) {
+		spinlock_acquire(&lock_pi_spinlock);
+		if (lock->lk_donation != 0 &&
+		    (cur->t_inherit == 0 || lock->lk_donation < cur->t_inherit)) {
+			cur->t_inherit = lock->lk_donation;
+		}
+		spinlock_release(&lock_pi_spinlock);
+	}
+
+	if (lock->lk_stat != NULL) {
+		lockstat_acquired(lock->lk_stat, contended, spins);
+	}
+}
+
+/*
+ * Take LOCK off our held list.
+ */
+static
+void
+lock_unheld(struct lock *lock)
+{
+	struct lock **pp;
+
+	pp = &curthread->t_heldlocks;
+	while (*pp != lock) {
+		KASSERT(*pp != NULL);
+		pp = &(*pp)->lk_nextheld;
+	}
+	*pp = lock->lk_nextheld;
+	lock->lk_nextheld = NULL;
+}
+
+/*
+ * Try once to take the lock without blocking. Returns true on success.
+ */
+static
+bool
+lock_tryacquire(struct lock *lock)
+{
+	if (spinlock_data_get(&lock->lk_locked) != 0) {
+		return false;
+	}
+	if (spinlock_data_testandset(&lock->lk_locked) != 0) {
+		return false;
+	}
+	membar_store_any();
+	lock->lk_holder = curthread;
+	return true;
+}
+
+/*
+ * Decide whether it's worth spinning for the lock: only if someone
+ * holds it and is actually running, on some other cpu. We look at the
+ * holder without any locking, so the answer may be stale (the holder
+ * may even have exited and been freed since), but it is only a hint.
+ */
+static
+bool
+lock_holder_running(struct lock *lock)
+{
+	struct thread *holder;
+
+	holder = lock->lk_holder;
+	return holder != NULL && holder->t_state == S_RUN &&
+		holder->t_cpu != curcpu->c_self;
+}
+
+/*
+ * Sleep path of lock_acquire, for a thread that is already counted in
+ * lk_waiters: either one that came through lock_acquire, or one moved
+ * over from a CV by cv_signal/cv_broadcast. Call with lk_spinlock held.
+ * CONTENDED and SPINS are for lockstat.
+ */
+static
+void
+lock_wait(struct lock *lock, bool contended, unsigned spins)
+{
+	KASSERT(spinlock_do_i_hold(&lock->lk_spinlock));
+
+	while (!lock_tryacquire(lock)) {
+		contended = true;
+
+		spinlock_acquire(&lock_pi_spinlock);
+		curthread->t_blockedon = lock;
+		lock_lend(lock, thread_stride(curthread));
+		spinlock_release(&lock_pi_spinlock);
+
+		wchan_sleep(lock->lk_wchan, &lock->lk_spinlock);
+	}
+
+	/* Must stop being a link in the chain before leaving lk_waiters. */
+	if (curthread->t_blockedon != NULL) {
+		spinlock_acquire(&lock_pi_spinlock);
+		curthread->t_blockedon = NULL;
+		spinlock_release(&lock_pi_spinlock);
+	}
+	lock->lk_waiters--;
+
+	lock_acquired(lock, contended, spins);
+}
+
 void
 lock_acquire(struct lock *lock)
 {
-        // Write this
+	unsigned spins;
+
+	KASSERT(lock != NULL);
+
+	/* Sleep locks need a thread; before thread_bootstrap use a spinlock. */
+	KASSERT(curthread != NULL);
 
-        (void)lock;  // suppress warning until code gets written
+	/* May not block in an interrupt handler. */
+	KASSERT(curthread->t_in_interrupt == false);
+
+	/* Don't deadlock against ourselves. */
+	KASSERT(lock->lk_holder != curthread);
+
+	/* Fast path: uncontended. */
+	if (lock_tryacquire(lock)) {
+		lock_acquired(lock, false, 0);
+		return;
+	}
+
+	/* Adaptive path: spin while the holder is busy elsewhere. */
+	for (spins = 0; spins < LOCK_SPIN_MAX && lock_holder_running(lock);
+	     spins++) {
+		if (lock_tryacquire(lock)) {
+			lock_acquired(lock, true, spins);
+			return;
+		}
+	}
+
+	/*
+	 * Slow path: sleep. Announce ourselves in lk_waiters before
+	 * the final attempt, so that a lock_release that runs after
+	 * that attempt fails is sure to see us and wake us up.
+	 */
+	spinlock_acquire(&lock->lk_spinlock);
+	lock->lk_waiters++;
+	membar_any_any();
+	lock_wait(lock, true, spins);
+	spinlock_release(&lock->lk_spinlock);
 }
 
 void
 lock_release(struct lock *lock)
 {
-        // Write this
+	struct thread *cur = curthread;
+	unsigned waiters;
+
+	KASSERT(lock != NULL);
+	KASSERT(lock->lk_holder == cur);
+
+	if (lock->lk_stat != NULL) {
+		lockstat_released(lock->lk_stat);
+	}
+
+	lock_unheld(lock);
+
+	lock->lk_holder = NULL;
+	membar_any_store();
+	spinlock_data_set(&lock->lk_locked, 0);
+
+	/* Pairs with the barrier in the sleep path of lock_acquire. */
+	membar_any_any();
+	waiters = lock->lk_waiters;
+	if (waiters > 0) {
+		spinlock_acquire(&lock->lk_spinlock);
+		wchan_wakeone(lock->lk_wchan, &lock->lk_spinlock);
+		spinlock_release(&lock->lk_spinlock);
+	}
 
-        (void)lock;  // suppress warning until code gets written
+	/*
+	 * Give back whatever we borrowed through this lock. With
+	 * waiters we must come through here even if we borrowed
+	 * nothing; see the priority inheritance comment above.
+	 */
+	if (waiters > 0 || cur->t_inherit != 0 || lock->lk_donation != 0) {
+		spinlock_acquire(&lock_pi_spinlock);
+		if (lock->lk_waiters == 0) {
+			lock->lk_donation = 0;
+		}
+		cur->t_inherit = lock_inherited(cur);
+		spinlock_release(&lock_pi_spinlock);
+	}
 }
 
 bool
 lock_do_i_hold(struct lock *lock)
 {
-        // Write this
+	KASSERT(lock != NULL);
 
-        (void)lock;  // suppress warning until code gets written
+	return lock->lk_holder == curthread;
+}
 
-        return true; // dummy until code gets written
+void
+lock_setstat(struct lock *lock, struct lockstat *ls)
+{
+	KASSERT(lock != NULL);
+
+	lock->lk_stat = ls;
 }
 
 ////////////////////////////////////////////////////////////
@@ -217,7 +585,14 @@ cv_create(const char *name)
                 return NULL;
         }
 
-        // add stuff here as needed
+	cv->cv_wchan = wchan_create(cv->cv_name);
+	if (cv->cv_wchan == NULL) {
+		kfree(cv->cv_name);
+		kfree(cv);
+		return NULL;
+	}
+
+	spinlock_init(&cv->cv_spinlock);
 
         return cv;
 }
@@ -227,7 +602,9 @@ cv_destroy(struct cv *cv)
 {
         KASSERT(cv != NULL);
 
-        // add stuff here as needed
+	/* wchan_cleanup will assert if anyone's waiting on it */
+	spinlock_cleanup(&cv->cv_spinlock);
+	wchan_destroy(cv->cv_wchan);
 
         kfree(cv->cv_name);
         kfree(cv);
@@ -236,23 +613,209 @@ cv_destroy(struct cv *cv)
 void
 cv_wait(struct cv *cv, struct lock *lock)
 {
-        // Write this
-        (void)cv;    // suppress warning until code gets written
-        (void)lock;  // suppress warning until code gets written
+	KASSERT(cv != NULL);
+	KASSERT(lock_do_i_hold(lock));
+
+	/*
+	 * Release the lock only once we hold the CV spinlock, so a
+	 * signal can't get in between and be lost.
+	 */
+	spinlock_acquire(&cv->cv_spinlock);
+	lock_release(lock);
+	wchan_sleep(cv->cv_wchan, &cv->cv_spinlock);
+	spinlock_release(&cv->cv_spinlock);
+
+	/*
+	 * Whoever signalled us moved us to the lock's wait channel and
+	 * counted us in lk_waiters, and lock_release has since woken
+	 * us. Finish taking the lock from there.
+	 */
+	spinlock_acquire(&lock->lk_spinlock);
+	lock_wait(lock, false, 0);
+	spinlock_release(&lock->lk_spinlock);
+}
+
+/*
+ * Move one waiter, or all of them, from CV to LOCK's wait channel.
+ * Lock order is CV spinlock, then lock spinlock.
+ */
+static
+void
+cv_requeue(struct cv *cv, struct lock *lock, bool all)
+{
+	unsigned moved;
+
+	KASSERT(cv != NULL);
+	KASSERT(lock_do_i_hold(lock));
+
+	spinlock_acquire(&cv->cv_spinlock);
+	spinlock_acquire(&lock->lk_spinlock);
+	moved = wchan_requeue(cv->cv_wchan, &cv->cv_spinlock,
+			      lock->lk_wchan, &lock->lk_spinlock, all);
+	lock->lk_waiters += moved;
+	spinlock_release(&lock->lk_spinlock);
+	spinlock_release(&cv->cv_spinlock);
 }
 
 void
 cv_signal(struct cv *cv, struct lock *lock)
 {
-        // Write this
-	(void)cv;    // suppress warning until code gets written
-	(void)lock;  // suppress warning until code gets written
+	cv_requeue(cv, lock, false);
 }
 
 void
 cv_broadcast(struct cv *cv, struct lock *lock)
 {
-	// Write this
-	(void)cv;    // suppress warning until code gets written
-	(void)lock;  // suppress warning until code gets written
+	cv_requeue(cv, lock, true);
+}
+
+////////////////////////////////////////////////////////////
+//
+// Reader-writer lock.
+
+struct rwlock *
+rwlock_create(const char *name)
+{
+	struct rwlock *rw;
+
+	rw = kmalloc(sizeof(*rw));
+	if (rw == NULL) {
+		return NULL;
+	}
+
+	rw->rwlk_name = kstrdup(name);
+	if (rw->rwlk_name == NULL) {
+		kfree(rw);
+		return NULL;
+	}
+
+	rw->rwlk_rwchan = wchan_create(rw->rwlk_name);
+	if (rw->rwlk_rwchan == NULL) {
+		kfree(rw->rwlk_name);
+		kfree(rw);
+		return NULL;
+	}
+
+	rw->rwlk_wwchan = wchan_create(rw->rwlk_name);
+	if (rw->rwlk_wwchan == NULL) {
+		wchan_destroy(rw->rwlk_rwchan);
+		kfree(rw->rwlk_name);
+		kfree(rw);
+		return NULL;
+	}
+
+	spinlock_init(&rw->rwlk_spinlock);
+	rw->rwlk_readers = 0;
+	rw->rwlk_wwaiters = 0;
+	rw->rwlk_writer = false;
+	rw->rwlk_stat = NULL;
+
+	return rw;
+}
+
+void
+rwlock_destroy(struct rwlock *rw)
+{
+	KASSERT(rw != NULL);
+	KASSERT(rw->rwlk_readers == 0);
+	KASSERT(rw->rwlk_wwaiters == 0);
+	KASSERT(!rw->rwlk_writer);
+
+	spinlock_cleanup(&rw->rwlk_spinlock);
+	wchan_destroy(rw->rwlk_wwchan);
+	wchan_destroy(rw->rwlk_rwchan);
+
+	kfree(rw->rwlk_name);
+	kfree(rw);
+}
+
+void
+rwlock_acquire_read(struct rwlock *rw)
+{
+	bool contended = false;
+
+	KASSERT(rw != NULL);
+
+	spinlock_acquire(&rw->rwlk_spinlock);
+	/* Wait behind an active writer and also behind waiting ones. */
+	while (rw->rwlk_writer || rw->rwlk_wwaiters > 0) {
+		contended = true;
+		wchan_sleep(rw->rwlk_rwchan, &rw->rwlk_spinlock);
+	}
+	rw->rwlk_readers++;
+	if (rw->rwlk_stat != NULL) {
+		lockstat_acquired_shared(rw->rwlk_stat, contended);
+	}
+	spinlock_release(&rw->rwlk_spinlock);
+}
+
+void
+rwlock_release_read(struct rwlock *rw)
+{
+	KASSERT(rw != NULL);
+
+	spinlock_acquire(&rw->rwlk_spinlock);
+	KASSERT(rw->rwlk_readers > 0);
+	KASSERT(!rw->rwlk_writer);
+	rw->rwlk_readers--;
+	if (rw->rwlk_readers == 0 && rw->rwlk_wwaiters > 0) {
+		wchan_wakeone(rw->rwlk_wwchan, &rw->rwlk_spinlock);
+	}
+	spinlock_release(&rw->rwlk_spinlock);
+}
+
+void
+rwlock_acquire_write(struct rwlock *rw)
+{
+	bool contended = false;
+
+	KASSERT(rw != NULL);
+
+	spinlock_acquire(&rw->rwlk_spinlock);
+	if (rw->rwlk_writer || rw->rwlk_readers > 0) {
+		contended = true;
+		rw->rwlk_wwaiters++;
+		do {
+			wchan_sleep(rw->rwlk_wwchan, &rw->rwlk_spinlock);
+		} while (rw->rwlk_writer || rw->rwlk_readers > 0);
+		rw->rwlk_wwaiters--;
+	}
+	rw->rwlk_writer = true;
+	if (rw->rwlk_stat != NULL) {
+		lockstat_acquired(rw->rwlk_stat, contended, 0);
+	}
+	spinlock_release(&rw->rwlk_spinlock);
+}
+
+void
+rwlock_release_write(struct rwlock *rw)
+{
+	KASSERT(rw != NULL);
+
+	spinlock_acquire(&rw->rwlk_spinlock);
+	KASSERT(rw->rwlk_writer);
+	KASSERT(rw->rwlk_readers == 0);
+	if (rw->rwlk_stat != NULL) {
+		lockstat_released(rw->rwlk_stat);
+	}
+	rw->rwlk_writer = false;
+	/*
+	 * Hand off to the next writer if there is one; otherwise let
+	 * all the waiting readers in at once.
+	 */
+	if (rw->rwlk_wwaiters > 0) {
+		wchan_wakeone(rw->rwlk_wwchan, &rw->rwlk_spinlock);
+	}
+	else {
+		wchan_wakeall(rw->rwlk_rwchan, &rw->rwlk_spinlock);
+	}
+	spinlock_release(&rw->rwlk_spinlock);
+}
+
+void
+rwlock_setstat(struct rwlock *rw, struct lockstat *ls)
+{
+	KASSERT(rw != NULL);
+
+	rw->rwlk_stat = ls;
 }
@@ -40,6 +40,8 @@
 #include <cpu.h>
 #include <spl.h>
 #include <spinlock.h>
+#include <membar.h>
+#include <clock.h>
 #include <wchan.h>
 #include <thread.h>
 #include <threadlist.h>
@@ -47,6 +49,7 @@
 #include <proc.h>
 #include <current.h>
 #include <synch.h>
+#include <rcu.h>
 #include <addrspace.h>
 #include <mainbus.h>
 #include <vnode.h>
@@ -55,6 +58,12 @@
 /* Magic number used as a guard value on kernel thread stacks. */
 #define THREAD_STACK_MAGIC 0xbaadf00d
 
+/* Maximum number of dead threads each cpu keeps around for reuse. */
+#define THREAD_CACHE_MAX 8
+
+/* Compare stride scheduling pass values, allowing for wraparound. */
+#define PASS_BEFORE(a, b) ((int)((a) - (b)) < 0)
+
 /* Wait channel. A wchan is protected by an associated, passed-in spinlock. */
 struct wchan {
 	const char *wc_name;		/* name for this channel */
@@ -69,6 +78,13 @@ static struct cpuarray allcpus;
 /* Used to wait for secondary CPUs to come online. */
 static struct semaphore *cpu_startup_sem;
 
+/*
+ * Run queue latency tracing switch. Off by default: it reads the clock
+ * on every wakeup and dispatch, and the clock device isn't attached
+ * until partway through boot.
+ */
+static volatile bool schedlat_enabled;
+
 ////////////////////////////////////////////////////////////
 
 /*
@@ -108,6 +124,43 @@ thread_checkstack(struct thread *thread)
 	}
 }
 
+/*
+ * Initialize the fields of a thread, other than its name and stack.
+ * This is used both for fresh threads and for recycled ones.
+ */
+static
+void
+thread_init(struct thread *thread)
+{
+	thread->t_wchan_name = "NEW";
+	thread->t_state = S_READY;
+
+	/* Thread subsystem fields */
+	thread_machdep_init(&thread->t_machdep);
+	threadlistnode_init(&thread->t_listnode, thread);
+	thread->t_context = NULL;
+	thread->t_cpu = NULL;
+	thread->t_proc = NULL;
+	thread->t_slicestart = 0;
+	thread->t_pass = 0;
+	thread->t_inherit = 0;
+	thread->t_blockedon = NULL;
+	thread->t_heldlocks = NULL;
+	thread->t_readytime.tv_sec = 0;
+	thread->t_readytime.tv_nsec = 0;
+
+	/* Interrupt state fields */
+	thread->t_in_interrupt = false;
+	thread->t_intr_user = false;
+	thread->t_curspl = IPL_HIGH;
+	thread->t_iplhigh_count = 1; /* corresponding to t_curspl */
+
+	/* Resource usage */
+	bzero(&thread->t_usage, sizeof(thread->t_usage));
+
+	/* If you add to struct thread, be sure to initialize here */
+}
+
 /*
  * Create a thread. This is used both to create a first thread
  * for each CPU and to create subsequent forked threads.
@@ -130,23 +183,49 @@ thread_create(const char *name)
 		kfree(thread);
 		return NULL;
 	}
-	thread->t_wchan_name = "NEW";
-	thread->t_state = S_READY;
-
-	/* Thread subsystem fields */
-	thread_machdep_init(&thread->t_machdep);
-	threadlistnode_init(&thread->t_listnode, thread);
 	thread->t_stack = NULL;
-	thread->t_context = NULL;
-	thread->t_cpu = NULL;
-	thread->t_proc = NULL;
+	thread_init(thread);
 
-	/* Interrupt state fields */
-	thread->t_in_interrupt = false;
-	thread->t_curspl = IPL_HIGH;
-	thread->t_iplhigh_count = 1; /* corresponding to t_curspl */
+	return thread;
+}
 
-	/* If you add to struct thread, be sure to initialize here */
+/*
+ * Get a thread, complete with stack, from the current cpu's cache of
+ * dead threads (see exorcise). Returns NULL if the cache is empty.
+ */
+static
+struct thread *
+thread_recycle(const char *name)
+{
+	struct thread *thread;
+	char *namecopy;
+	int spl;
+
+	DEBUGASSERT(name != NULL);
+
+	/* The cache is per-cpu; keep exorcise() and migration out. */
+	spl = splhigh();
+	thread = threadlist_remhead(&curcpu->c_threadcache);
+	splx(spl);
+
+	if (thread == NULL) {
+		return NULL;
+	}
+
+	namecopy = kstrdup(name);
+	if (namecopy == NULL) {
+		spl = splhigh();
+		threadlist_addhead(&curcpu->c_threadcache, thread);
+		splx(spl);
+		return NULL;
+	}
+
+	KASSERT(thread->t_stack != NULL);
+	thread->t_name = namecopy;
+	thread_init(thread);
+
+	/* Put the guard band back; the old thread's frames are garbage. */
+	thread_checkstack_init(thread);
 
 	return thread;
 }
@@ -176,12 +255,21 @@ cpu_create(unsigned hardware_number)
 
 	c->c_curthread = NULL;
 	threadlist_init(&c->c_zombies);
+	threadlist_init(&c->c_threadcache);
 	c->c_hardclocks = 0;
 	c->c_spinlocks = 0;
+	c->c_rcu_seen = 0;
+	c->c_counters_seq = 0;
+	bzero(c->c_counters, sizeof(c->c_counters));
+	c->c_syscallstat_gen = 0;
+	bzero(c->c_syscallstat, sizeof(c->c_syscallstat));
 
 	c->c_isidle = false;
+	c->c_pass = 0;
 	threadlist_init(&c->c_runqueue);
-	spinlock_init(&c->c_runqueue_lock);
+	spinlock_init_ticket(&c->c_runqueue_lock);
+	bzero(c->c_schedlat, sizeof(c->c_schedlat));
+	c->c_schedlat_max = 0;
 
 	c->c_ipi_pending = 0;
 	c->c_numshootdown = 0;
@@ -192,6 +280,10 @@ cpu_create(unsigned hardware_number)
 		panic("cpu_create: array_add: %s\n", strerror(result));
 	}
 
+	snprintf(namebuf, sizeof(namebuf), "cpu%u runqueue", c->c_number);
+	lockstat_init(&c->c_runqueue_stat, namebuf);
+	spinlock_setstat(&c->c_runqueue_lock, &c->c_runqueue_stat);
+
 	snprintf(namebuf, sizeof(namebuf), "<boot #%d>", c->c_number);
 	c->c_curthread = thread_create(namebuf);
 	if (c->c_curthread == NULL) {
@@ -284,11 +376,38 @@ thread_destroy(struct thread *thread)
 	kfree(thread);
 }
 
+/*
+ * Retire a zombie into the current cpu's thread cache, keeping the
+ * struct thread and its stack for thread_recycle() to hand out again.
+ * Everything else is released as in thread_destroy.
+ */
+static
+void
+thread_cache_put(struct thread *thread)
+{
+	KASSERT(thread != curthread);
+	KASSERT(thread->t_state != S_RUN);
+	KASSERT(thread->t_proc == NULL);
+	KASSERT(thread->t_stack != NULL);
+
+	/* A corrupted stack must not be handed out again. */
+	thread_checkstack(thread);
+
+	thread_machdep_cleanup(&thread->t_machdep);
+	kfree(thread->t_name);
+	thread->t_name = NULL;
+	thread->t_wchan_name = "CACHED";
+
+	threadlist_addtail(&curcpu->c_threadcache, thread);
+}
+
 /*
  * Clean up zombies. (Zombies are threads that have exited but still
  * need to have thread_destroy called on them.)
  *
- * The list of zombies is per-cpu.
+ * The list of zombies is per-cpu. So is the cache of dead threads;
+ * zombies go there first, as long as it has room, so thread_fork can
+ * reuse them without allocating a new stack.
  */
 static
 void
@@ -299,7 +418,13 @@ exorcise(void)
 	while ((z = threadlist_remhead(&curcpu->c_zombies)) != NULL) {
 		KASSERT(z != curthread);
 		KASSERT(z->t_state == S_ZOMBIE);
-		thread_destroy(z);
+		if (z->t_stack != NULL &&
+		    curcpu->c_threadcache.tl_count < THREAD_CACHE_MAX) {
+			thread_cache_put(z);
+		}
+		else {
+			thread_destroy(z);
+		}
 	}
 }
 
@@ -461,9 +586,21 @@ thread_make_runnable(struct thread *target, bool already_have_lock)
 		spinlock_acquire(&targetcpu->c_runqueue_lock);
 	}
 
+	/*
+	 * Don't let a thread bank cpu credit while it was asleep (or
+	 * before it ever ran): it rejoins no earlier than the thread
+	 * that is running now.
+	 */
+	if (PASS_BEFORE(target->t_pass, targetcpu->c_pass)) {
+		target->t_pass = targetcpu->c_pass;
+	}
+
 	/* Target thread is now ready to run; put it on the run queue. */
 	target->t_state = S_READY;
 	threadlist_addtail(&targetcpu->c_runqueue, target);
+	if (schedlat_enabled) {
+		gettime(&target->t_readytime);
+	}
 
 	if (targetcpu->c_isidle && targetcpu != curcpu->c_self) {
 		/*
@@ -478,6 +615,76 @@ thread_make_runnable(struct thread *target, bool already_have_lock)
 	}
 }
 
+/*
+ * Record how long thread T sat on cpu C's run queue, if it was stamped
+ * when it was made runnable. (Threads queued before tracing was turned
+ * on aren't stamped and are skipped.) The run queue lock must be held.
+ */
+static
+void
+thread_schedlat_record(struct cpu *c, struct thread *t)
+{
+	struct timespec now, wait;
+	unsigned usec, bucket;
+
+	if (t->t_readytime.tv_sec == 0 && t->t_readytime.tv_nsec == 0) {
+		return;
+	}
+
+	gettime(&now);
+	timespec_sub(&now, &t->t_readytime, &wait);
+	t->t_readytime.tv_sec = 0;
+	t->t_readytime.tv_nsec = 0;
+
+	if (wait.tv_sec < 0) {
+		/* clock went backwards?! */
+		return;
+	}
+	if (wait.tv_sec >= 4000) {
+		/* don't overflow; it's off the end of the histogram anyway */
+		usec = 4000000000U;
+	}
+	else {
+		usec = wait.tv_sec * 1000000 + wait.tv_nsec / 1000;
+	}
+
+	bucket = 0;
+	while (bucket < SCHEDLAT_BUCKETS - 1 && (usec >> (bucket + 1)) != 0) {
+		bucket++;
+	}
+	c->c_schedlat[bucket]++;
+	if (usec > c->c_schedlat_max) {
+		c->c_schedlat_max = usec;
+	}
+}
+
+/*
+ * Take the next thread to run off cpu C's run queue: the one with the
+ * lowest pass (see proc.h). Ties go to the one queued first, so equal
+ * strides give round-robin. Returns NULL if the queue is empty.
+ *
+ * The run queue lock must be held.
+ */
+static
+struct thread *
+thread_dequeue(struct cpu *c)
+{
+	struct thread *t, *best;
+
+	KASSERT(spinlock_do_i_hold(&c->c_runqueue_lock));
+
+	best = NULL;
+	THREADLIST_FORALL(t, c->c_runqueue) {
+		if (best == NULL || PASS_BEFORE(t->t_pass, best->t_pass)) {
+			best = t;
+		}
+	}
+	if (best != NULL) {
+		threadlist_remove(&c->c_runqueue, best);
+	}
+	return best;
+}
+
 /*
  * Create a new thread based on an existing one.
  *
@@ -497,18 +704,22 @@ thread_fork(const char *name,
 	struct thread *newthread;
 	int result;
 
-	newthread = thread_create(name);
+	/* Reuse a dead thread and its stack if we have one handy */
+	newthread = thread_recycle(name);
 	if (newthread == NULL) {
-		return ENOMEM;
-	}
+		newthread = thread_create(name);
+		if (newthread == NULL) {
+			return ENOMEM;
+		}
 
-	/* Allocate a stack */
-	newthread->t_stack = kmalloc(STACK_SIZE);
-	if (newthread->t_stack == NULL) {
-		thread_destroy(newthread);
-		return ENOMEM;
+		/* Allocate a stack */
+		newthread->t_stack = kmalloc(STACK_SIZE);
+		if (newthread->t_stack == NULL) {
+			thread_destroy(newthread);
+			return ENOMEM;
+		}
+		thread_checkstack_init(newthread);
 	}
-	thread_checkstack_init(newthread);
 
 	/*
 	 * Now we clone various fields from the parent thread.
@@ -567,6 +778,9 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 	/* Explicitly disable interrupts on this processor */
 	spl = splhigh();
 
+	/* Nobody calls this from inside an RCU read section. */
+	rcu_quiescent();
+
 	cur = curthread;
 
 	/*
@@ -591,6 +805,17 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 		return;
 	}
 
+	/*
+	 * Count the switch. Being kicked off the cpu from the timer
+	 * interrupt is involuntary; yielding or sleeping is not.
+	 */
+	if (newstate == S_READY && cur->t_in_interrupt) {
+		cur->t_usage.tu_nivcsw++;
+	}
+	else if (newstate != S_ZOMBIE) {
+		cur->t_usage.tu_nvcsw++;
+	}
+
 	/* Put the thread in the right place. */
 	switch (newstate) {
 	    case S_RUN:
@@ -638,14 +863,19 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 	/* The current cpu is now idle. */
 	curcpu->c_isidle = true;
 	do {
-		next = threadlist_remhead(&curcpu->c_runqueue);
+		next = thread_dequeue(curcpu->c_self);
 		if (next == NULL) {
 			spinlock_release(&curcpu->c_runqueue_lock);
 			cpu_idle();
+			rcu_quiescent();
 			spinlock_acquire(&curcpu->c_runqueue_lock);
 		}
 	} while (next == NULL);
 	curcpu->c_isidle = false;
+	curcpu->c_pass = next->t_pass;
+	if (schedlat_enabled) {
+		thread_schedlat_record(curcpu->c_self, next);
+	}
 
 	/*
 	 * Note that curcpu->c_curthread may be the same variable as
@@ -657,6 +887,9 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 	curcpu->c_curthread = next;
 	curthread = next;
 
+	/* Start the new thread's time slice. */
+	next->t_slicestart = curcpu->c_hardclocks;
+
 	/* do the switch (in assembler in switch.S) */
 	switchframe_switch(&cur->t_context, &next->t_context);
 
@@ -789,6 +1022,9 @@ thread_exit(void)
 	/* Make sure we *are* detached (move this only if you're sure!) */
 	KASSERT(cur->t_proc == NULL);
 
+	/* Exiting with a sleep lock held would leave it locked forever. */
+	KASSERT(cur->t_heldlocks == NULL);
+
 	/* Check the stack guard band. */
 	thread_checkstack(cur);
 
@@ -807,6 +1043,206 @@ thread_yield(void)
 	thread_switch(S_READY, NULL, NULL);
 }
 
+/*
+ * Accumulate resource usage counts.
+ */
+void
+threadusage_add(struct threadusage *to, const struct threadusage *from)
+{
+	to->tu_uticks += from->tu_uticks;
+	to->tu_sticks += from->tu_sticks;
+	to->tu_nvcsw += from->tu_nvcsw;
+	to->tu_nivcsw += from->tu_nivcsw;
+	to->tu_nfaults += from->tu_nfaults;
+}
+
+/*
+ * Stride to charge T per hardclock, allowing for priority inheritance.
+ * A thread that has left its process on the way out runs at the
+ * default priority.
+ */
+unsigned
+thread_stride(struct thread *t)
+{
+	unsigned stride;
+
+	stride = (t->t_proc != NULL) ? t->t_proc->p_stride : PRIO_STRIDE(0);
+	if (t->t_inherit != 0 && t->t_inherit < stride) {
+		stride = t->t_inherit;
+	}
+	return stride;
+}
+
+/*
+ * Called when T has just inherited a higher priority. If T is waiting
+ * on a run queue, move its pass up to the front of that cpu's virtual
+ * time, so it gets to run soon instead of after its old pass comes
+ * around. (If it is running it already has the cpu; if it is asleep
+ * there is nothing to do.)
+ */
+void
+thread_boost(struct thread *t)
+{
+	struct cpu *c;
+
+	c = t->t_cpu;
+	spinlock_acquire(&c->c_runqueue_lock);
+	if (t->t_cpu == c && t->t_state == S_READY &&
+	    PASS_BEFORE(c->c_pass, t->t_pass)) {
+		t->t_pass = c->c_pass;
+	}
+	spinlock_release(&c->c_runqueue_lock);
+}
+
+/*
+ * Turn run queue latency tracing on or off.
+ */
+void
+thread_schedlat_enable(bool on)
+{
+	schedlat_enabled = on;
+}
+
+/*
+ * Print each cpu's run queue latency histogram.
+ */
+void
+thread_schedlat_print(void)
+{
+	unsigned counts[SCHEDLAT_BUCKETS];
+	unsigned i, j, max, total;
+	struct cpu *c;
+
+	kprintf("Run queue latency tracing is %s\n",
+		schedlat_enabled ? "on" : "off");
+
+	for (i=0; i < cpuarray_num(&allcpus); i++) {
+		c = cpuarray_get(&allcpus, i);
+
+		/* Copy it out; can't kprintf holding a spinlock. */
+		spinlock_acquire(&c->c_runqueue_lock);
+		memcpy(counts, c->c_schedlat, sizeof(counts));
+		max = c->c_schedlat_max;
+		spinlock_release(&c->c_runqueue_lock);
+
+		total = 0;
+		for (j=0; j<SCHEDLAT_BUCKETS; j++) {
+			total += counts[j];
+		}
+		kprintf("cpu%u: %u dispatches, longest wait %u usec\n",
+			c->c_number, total, max);
+		for (j=0; j<SCHEDLAT_BUCKETS; j++) {
+			if (counts[j] == 0) {
+				continue;
+			}
+			if (j == SCHEDLAT_BUCKETS - 1) {
+				kprintf("    %10u+     usec: %u\n",
+					1U << j, counts[j]);
+			}
+			else {
+				kprintf("    %10u-%-10u usec: %u\n",
+					j == 0 ? 0 : 1U << j,
+					(1U << (j + 1)) - 1, counts[j]);
+			}
+		}
+	}
+}
+
+/*
+ * Clear all the run queue latency histograms.
+ */
+void
+thread_schedlat_reset(void)
+{
+	unsigned i;
+	struct cpu *c;
+
+	for (i=0; i < cpuarray_num(&allcpus); i++) {
+		c = cpuarray_get(&allcpus, i);
+		spinlock_acquire(&c->c_runqueue_lock);
+		bzero(c->c_schedlat, sizeof(c->c_schedlat));
+		c->c_schedlat_max = 0;
+		spinlock_release(&c->c_runqueue_lock);
+	}
+}
+
+/*
+ * Oldest RCU generation any cpu has seen. The values wrap, so compare
+ * them by difference.
+ */
+unsigned
+cpu_rcu_seen(void)
+{
+	unsigned i, seen, oldest;
+
+	oldest = curcpu->c_rcu_seen;
+	for (i=0; i < cpuarray_num(&allcpus); i++) {
+		seen = cpuarray_get(&allcpus, i)->c_rcu_seen;
+		if ((int)(seen - oldest) < 0) {
+			oldest = seen;
+		}
+	}
+	return oldest;
+}
+
+/*
+ * Add up one per-cpu counter slot. The other cpus keep counting while
+ * we look; that's fine, but each 64-bit slot is written in two halves,
+ * so read it under the cpu's c_counters_seq and retry if it moved.
+ */
+uint64_t
+cpu_counter_sum(unsigned slot)
+{
+	unsigned i, seq;
+	uint64_t sum, val;
+	struct cpu *c;
+
+	KASSERT(slot < COUNTER_SLOTS);
+
+	sum = 0;
+	for (i=0; i < cpuarray_num(&allcpus); i++) {
+		c = cpuarray_get(&allcpus, i);
+		do {
+			seq = c->c_counters_seq;
+			membar_load_load();
+			val = c->c_counters[slot];
+			membar_load_load();
+		} while ((seq & 1) != 0 || c->c_counters_seq != seq);
+		sum += val;
+	}
+	return sum;
+}
+
+/*
+ * Add up one syscall's stats over all cpus. A cpu that hasn't made
+ * any system call since the last reset still holds the old numbers
+ * (it clears them itself next time), so leave those out.
+ */
+void
+cpu_syscallstat_sum(unsigned slot, unsigned gen, struct syscallstat *ret)
+{
+	unsigned i, j;
+	struct cpu *c;
+	const struct syscallstat *ss;
+
+	KASSERT(slot < SYSCALL_NSTATS);
+
+	bzero(ret, sizeof(*ret));
+	for (i=0; i < cpuarray_num(&allcpus); i++) {
+		c = cpuarray_get(&allcpus, i);
+		if (c->c_syscallstat_gen != gen) {
+			continue;
+		}
+		ss = &c->c_syscallstat[slot];
+		ret->ss_calls += ss->ss_calls;
+		ret->ss_errors += ss->ss_errors;
+		ret->ss_usec += ss->ss_usec;
+		for (j=0; j<SYSCALL_HISTBUCKETS; j++) {
+			ret->ss_hist[j] += ss->ss_hist[j];
+		}
+	}
+}
+
 ////////////////////////////////////////////////////////////
 
 /*
@@ -913,6 +1349,11 @@ thread_consider_migration(void)
 				continue;
 			}
 
+			/*
+			 * Pass values are relative to each cpu's own
+			 * progress; keep the thread's lag the same.
+			 */
+			t->t_pass = t->t_pass - curcpu->c_pass + c->c_pass;
 			t->t_cpu = c;
 			threadlist_addtail(&c->c_runqueue, t);
 			DEBUG(DB_THREADS,
@@ -1039,6 +1480,27 @@ wchan_wakeone(struct wchan *wc, struct spinlock *lk)
 	thread_make_runnable(target, false);
 }
 
+/*
+ * Wake up thread T if it is sleeping on a wait channel. Returns true
+ * if it was.
+ */
+bool
+wchan_wakethread(struct wchan *wc, struct spinlock *lk, struct thread *t)
+{
+	struct thread *t2;
+
+	KASSERT(spinlock_do_i_hold(lk));
+
+	THREADLIST_FORALL(t2, wc->wc_threads) {
+		if (t2 == t) {
+			threadlist_remove(&wc->wc_threads, t);
+			thread_make_runnable(t, false);
+			return true;
+		}
+	}
+	return false;
+}
+
 /*
  * Wake up all threads sleeping on a wait channel.
  */
@@ -1072,6 +1534,75 @@ wchan_wakeall(struct wchan *wc, struct spinlock *lk)
 	threadlist_cleanup(&list);
 }
 
+/*
+ * Wake up at most N threads sleeping on a wait channel. Like
+ * wchan_wakeall, take them off the channel first and then make them
+ * runnable.
+ */
+unsigned
+wchan_waken(struct wchan *wc, unsigned n, struct spinlock *lk)
+{
+	struct thread *target;
+	struct threadlist list;
+	unsigned count = 0;
+
+	KASSERT(spinlock_do_i_hold(lk));
+
+	threadlist_init(&list);
+
+	while (count < n &&
+	       (target = threadlist_remhead(&wc->wc_threads)) != NULL) {
+		threadlist_addtail(&list, target);
+		count++;
+	}
+
+	while ((target = threadlist_remhead(&list)) != NULL) {
+		thread_make_runnable(target, false);
+	}
+
+	threadlist_cleanup(&list);
+	return count;
+}
+
+/*
+ * Move threads sleeping on wait channel FROM over to wait channel TO
+ * without waking them up: one thread, or all of them if ALL is true.
+ * Both associated spinlocks must be locked. Returns the number of
+ * threads moved.
+ *
+ * A moved thread stays asleep until someone wakes it from TO; when it
+ * does wake, it still returns from wchan_sleep holding the spinlock it
+ * originally went to sleep with.
+ */
+unsigned
+wchan_requeue(struct wchan *from, struct spinlock *fromlk,
+	      struct wchan *to, struct spinlock *tolk, bool all)
+{
+	struct thread *target;
+	unsigned count = 0;
+
+	KASSERT(spinlock_do_i_hold(fromlk));
+	KASSERT(spinlock_do_i_hold(tolk));
+	KASSERT(from != to);
+
+	/*
+	 * Don't check t_state here: thread_switch puts a thread on the
+	 * wchan's list and drops the spinlock before it gets to set
+	 * S_SLEEP, so a thread we see may still be in S_RUN. It's on the
+	 * list, though, and that's all moving it requires.
+	 */
+	while ((target = threadlist_remhead(&from->wc_threads)) != NULL) {
+		target->t_wchan_name = to->wc_name;
+		threadlist_addtail(&to->wc_threads, target);
+		count++;
+		if (!all) {
+			break;
+		}
+	}
+
+	return count;
+}
+
 /*
  * Return nonzero if there are no threads sleeping on the channel.
  * This is meant to be used only for diagnostic purposes.
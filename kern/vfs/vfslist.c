@@ -39,10 +39,12 @@
 #include <lib.h>
 #include <array.h>
 #include <synch.h>
+#include <lockstat.h>
 #include <vfs.h>
 #include <fs.h>
 #include <vnode.h>
 #include <device.h>
+#include <addrspace.h>
 
 /*
  * Structure for a single named device.
@@ -90,9 +92,21 @@ DEFARRAY(knowndev, static __UNUSED inline);
 
 static struct knowndevarray *knowndevs;
 
+/*
+ * Lock for knowndevs and the kd_fs fields of its entries. Changes are
+ * made holding both this (for writing) and the big lock, so reading
+ * them requires only one or the other. Code that doesn't otherwise
+ * need the big lock, like vfs_getdevname, can thus look up devices
+ * concurrently. This lock comes after the big lock, and nothing that
+ * might take the big lock may be called while holding only this.
+ */
+static struct rwlock *knowndevs_lock;
+
 /* The big lock for all FS ops. Remove for filesystem assignment. */
 static struct lock *vfs_biglock;
 static unsigned vfs_biglock_depth;
+static struct lockstat vfs_biglock_lockstat =
+	LOCKSTAT_INITIALIZER("vfs_biglock");
 
 
 /*
@@ -106,10 +120,16 @@ vfs_bootstrap(void)
 		panic("vfs: Could not create knowndevs array\n");
 	}
 
+	knowndevs_lock = rwlock_create("knowndevs");
+	if (knowndevs_lock==NULL) {
+		panic("vfs: Could not create knowndevs lock\n");
+	}
+
 	vfs_biglock = lock_create("vfs_biglock");
 	if (vfs_biglock==NULL) {
 		panic("vfs: Could not create vfs big lock\n");
 	}
+	lock_setstat(vfs_biglock, &vfs_biglock_lockstat);
 	vfs_biglock_depth = 0;
 
 	devnull_create();
@@ -264,7 +284,7 @@ vfs_getdevname(struct fs *fs)
 
 	KASSERT(fs != NULL);
 
-	KASSERT(vfs_biglock_do_i_hold());
+	rwlock_acquire_read(knowndevs_lock);
 
 	num = knowndevarray_num(knowndevs);
 	for (i=0; i<num; i++) {
@@ -277,10 +297,12 @@ vfs_getdevname(struct fs *fs)
 			 * the fs cannot go away, and the device can't
 			 * go away until the fs goes away.
 			 */
+			rwlock_release_read(knowndevs_lock);
 			return kd->kd_name;
 		}
 	}
 
+	rwlock_release_read(knowndevs_lock);
 	return NULL;
 }
 
@@ -423,7 +445,9 @@ vfs_doadd(const char *dname, int mountable, struct device *dev, struct fs *fs)
 		goto fail;
 	}
 
+	rwlock_acquire_write(knowndevs_lock);
 	result = knowndevarray_add(knowndevs, kd, &index);
+	rwlock_release_write(knowndevs_lock);
 	if (result) {
 		goto fail;
 	}
@@ -547,7 +571,9 @@ vfs_mount(const char *devname, void *data,
 	KASSERT(fs != NULL);
 	KASSERT(fs != SWAP_FS); 
 
+	rwlock_acquire_write(knowndevs_lock);
 	kd->kd_fs = fs;
+	rwlock_release_write(knowndevs_lock);
 
 	volname = FSOP_GETVOLNAME(fs);
 	kprintf("vfs: Mounted %s: on %s\n",
@@ -597,7 +623,9 @@ vfs_swapon(const char *devname, struct vnode **ret)
 
 	kprintf("vfs: Swap attached to %s\n", kd->kd_name);
 
+	rwlock_acquire_write(knowndevs_lock);
 	kd->kd_fs = SWAP_FS;
+	rwlock_release_write(knowndevs_lock);
 	VOP_INCREF(kd->kd_vnode);
 	*ret = kd->kd_vnode;
 
@@ -620,6 +648,9 @@ vfs_unmount(const char *devname)
 	struct knowndev *kd;
 	int result;
 
+	/* cached executables hold vnodes, which would keep the fs busy */
+	execcache_purge();
+
 	vfs_biglock_acquire();
 
 	result = findmount(devname, &kd);
@@ -648,7 +679,9 @@ vfs_unmount(const char *devname)
 	kprintf("vfs: Unmounted %s:\n", kd->kd_name);
 
 	/* now drop the filesystem */
+	rwlock_acquire_write(knowndevs_lock);
 	kd->kd_fs = NULL;
+	rwlock_release_write(knowndevs_lock);
 
 	KASSERT(result==0);
 
@@ -685,7 +718,9 @@ vfs_swapoff(const char *devname)
 	kprintf("vfs: Swap detached from %s:\n", kd->kd_name);
 
 	/* drop it */
+	rwlock_acquire_write(knowndevs_lock);
 	kd->kd_fs = NULL;
+	rwlock_release_write(knowndevs_lock);
 
 	KASSERT(result==0);
 
@@ -704,6 +739,8 @@ vfs_unmountall(void)
 	unsigned i, num;
 	int result;
 
+	execcache_purge();
+
 	vfs_biglock_acquire();
 
 	num = knowndevarray_num(knowndevs);
@@ -719,7 +756,9 @@ vfs_unmountall(void)
 		}
 		if (dev->kd_fs == SWAP_FS) {
 			/* just drop it */
+			rwlock_acquire_write(knowndevs_lock);
 			dev->kd_fs = NULL;
+			rwlock_release_write(knowndevs_lock);
 			continue;
 		}
 
@@ -757,7 +796,9 @@ vfs_unmountall(void)
 		}
 
 		/* now drop the filesystem */
+		rwlock_acquire_write(knowndevs_lock);
 		dev->kd_fs = NULL;
+		rwlock_release_write(knowndevs_lock);
 	}
 
 	vfs_biglock_release();
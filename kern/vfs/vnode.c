@@ -52,6 +52,8 @@ vnode_init(struct vnode *vn, const struct vnode_ops *ops,
 	spinlock_init(&vn->vn_countlock);
 	vn->vn_fs = fs;
 	vn->vn_data = fsdata;
+	vn->vn_writers = 0;
+	vn->vn_writegen = 0;
 	return 0;
 }
 
@@ -86,6 +88,75 @@ vnode_incref(struct vnode *vn)
 	spinlock_release(&vn->vn_countlock);
 }
 
+/*
+ * Note the start and end of a write or truncate.
+ */
+static
+void
+vnode_startwrite(struct vnode *vn)
+{
+	spinlock_acquire(&vn->vn_countlock);
+	vn->vn_writers++;
+	spinlock_release(&vn->vn_countlock);
+}
+
+static
+void
+vnode_endwrite(struct vnode *vn)
+{
+	spinlock_acquire(&vn->vn_countlock);
+	KASSERT(vn->vn_writers > 0);
+	vn->vn_writers--;
+	vn->vn_writegen++;
+	spinlock_release(&vn->vn_countlock);
+}
+
+/*
+ * Write to a file, bumping the write generation.
+ * Called by VOP_WRITE.
+ */
+int
+vnode_write(struct vnode *vn, struct uio *uio)
+{
+	int result;
+
+	vnode_startwrite(vn);
+	result = __VOP(vn, write)(vn, uio);
+	vnode_endwrite(vn);
+	return result;
+}
+
+/*
+ * Likewise for truncate.
+ * Called by VOP_TRUNCATE.
+ */
+int
+vnode_truncate(struct vnode *vn, off_t pos)
+{
+	int result;
+
+	vnode_startwrite(vn);
+	result = __VOP(vn, truncate)(vn, pos);
+	vnode_endwrite(vn);
+	return result;
+}
+
+/*
+ * Get the write generation, unless a write or truncate is in
+ * progress, in which case return false.
+ */
+bool
+vnode_writegen(struct vnode *vn, unsigned *gen)
+{
+	bool ok;
+
+	spinlock_acquire(&vn->vn_countlock);
+	ok = vn->vn_writers == 0;
+	*gen = vn->vn_writegen;
+	spinlock_release(&vn->vn_countlock);
+	return ok;
+}
+
 /*
  * Decrement refcount.
  * Called by VOP_DECREF.
@@ -180,3 +180,29 @@ as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 	return 0;
 }
 
+
+int
+as_translate(struct addrspace *as, vaddr_t vaddr, paddr_t *ret)
+{
+	/*
+	 * Write this.
+	 */
+
+	(void)as;
+	(void)vaddr;
+	(void)ret;
+
+	return EFAULT;
+}
+
+void
+as_setkinfo(struct addrspace *as, pid_t pid, pid_t ppid)
+{
+	/*
+	 * Write this.
+	 */
+
+	(void)as;
+	(void)pid;
+	(void)ppid;
+}
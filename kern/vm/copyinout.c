@@ -142,12 +142,63 @@ copycheck(const_userptr_t userptr, size_t len, size_t *stoplen)
 	return 0;
 }
 
+/*
+ * Fast block copy for copyin and copyout. memcpy only goes a word at
+ * a time if both pointers and the length are all word-aligned; user
+ * buffers often aren't, so as long as the two pointers are aligned
+ * the same way, copy bytes up to a word boundary, then words (four
+ * per iteration), then the leftover bytes.
+ */
+static
+void
+copymem(void *dst, const void *src, size_t len)
+{
+	char *d = dst;
+	const char *s = src;
+	uint32_t *dw;
+	const uint32_t *sw;
+
+	if (((uintptr_t)d ^ (uintptr_t)s) % sizeof(uint32_t) != 0) {
+		/* can never line up */
+		memcpy(d, s, len);
+		return;
+	}
+
+	while (len > 0 && (uintptr_t)d % sizeof(uint32_t) != 0) {
+		*d++ = *s++;
+		len--;
+	}
+
+	dw = (uint32_t *)d;
+	sw = (const uint32_t *)s;
+	while (len >= 4 * sizeof(uint32_t)) {
+		dw[0] = sw[0];
+		dw[1] = sw[1];
+		dw[2] = sw[2];
+		dw[3] = sw[3];
+		dw += 4;
+		sw += 4;
+		len -= 4 * sizeof(uint32_t);
+	}
+	while (len >= sizeof(uint32_t)) {
+		*dw++ = *sw++;
+		len -= sizeof(uint32_t);
+	}
+
+	d = (char *)dw;
+	s = (const char *)sw;
+	while (len > 0) {
+		*d++ = *s++;
+		len--;
+	}
+}
+
 /*
  * copyin
  *
  * Copy a block of memory of length LEN from user-level address USERSRC
- * to kernel address DEST. We can use memcpy because it's protected by
- * the tm_badfaultfunc/copyfail logic.
+ * to kernel address DEST. We can use plain memory accesses because
+ * they're protected by the tm_badfaultfunc/copyfail logic.
  */
 int
 copyin(const_userptr_t usersrc, void *dest, size_t len)
@@ -172,7 +223,7 @@ copyin(const_userptr_t usersrc, void *dest, size_t len)
 		return EFAULT;
 	}
 
-	memcpy(dest, (const void *)usersrc, len);
+	copymem(dest, (const void *)usersrc, len);
 
 	curthread->t_machdep.tm_badfaultfunc = NULL;
 	return 0;
@@ -182,8 +233,8 @@ copyin(const_userptr_t usersrc, void *dest, size_t len)
  * copyout
  *
  * Copy a block of memory of length LEN from kernel address SRC to
- * user-level address USERDEST. We can use memcpy because it's
- * protected by the tm_badfaultfunc/copyfail logic.
+ * user-level address USERDEST. We can use plain memory accesses
+ * because they're protected by the tm_badfaultfunc/copyfail logic.
  */
 int
 copyout(const void *src, userptr_t userdest, size_t len)
@@ -208,7 +259,7 @@ copyout(const void *src, userptr_t userdest, size_t len)
 		return EFAULT;
 	}
 
-	memcpy((void *)userdest, src, len);
+	copymem((void *)userdest, src, len);
 
 	curthread->t_machdep.tm_badfaultfunc = NULL;
 	return 0;
@@ -229,15 +280,52 @@ copyout(const void *src, userptr_t userdest, size_t len)
  * hit STOPLEN it's because the string has run into the end of
  * userspace. Thus in the latter case we return EFAULT, not
  * ENAMETOOLONG.
+ *
+ * Once SRC is word-aligned, read it a word at a time and check the
+ * whole word for a null byte at once; only the word holding the
+ * terminator (or running past a limit) is done bytewise. Aligned
+ * reads never cross a page, so this never touches a page the string
+ * doesn't extend into.
  */
+
+/* Nonzero iff some byte of W is zero. */
+#define HASZERO(w) (((w) - 0x01010101U) & ~(w) & 0x80808080U)
+
 static
 int
 copystr(char *dest, const char *src, size_t maxlen, size_t stoplen,
 	size_t *gotlen)
 {
-	size_t i;
+	size_t i, limit;
+	uint32_t w;
+
+	limit = maxlen < stoplen ? maxlen : stoplen;
+	i = 0;
+	while (i < limit && (uintptr_t)(src + i) % sizeof(uint32_t) != 0) {
+		dest[i] = src[i];
+		if (src[i] == 0) {
+			if (gotlen != NULL) {
+				*gotlen = i+1;
+			}
+			return 0;
+		}
+		i++;
+	}
+	while (i + sizeof(uint32_t) <= limit) {
+		w = *(const uint32_t *)(src + i);
+		if (HASZERO(w)) {
+			break;
+		}
+		if ((uintptr_t)(dest + i) % sizeof(uint32_t) == 0) {
+			*(uint32_t *)(dest + i) = w;
+		}
+		else {
+			memcpy(dest + i, &w, sizeof(w));
+		}
+		i += sizeof(uint32_t);
+	}
 
-	for (i=0; i<maxlen && i<stoplen; i++) {
+	for (; i<maxlen && i<stoplen; i++) {
 		dest[i] = src[i];
 		if (src[i] == 0) {
 			if (gotlen != NULL) {
@@ -319,3 +407,55 @@ copyoutstr(const char *src, userptr_t userdest, size_t len, size_t *actual)
 	curthread->t_machdep.tm_badfaultfunc = NULL;
 	return result;
 }
+
+/*
+ * copyinptrs
+ *
+ * Copy a null-terminated array of user pointers (such as execv's
+ * argv) from user-level address USERSRC into DEST, which has room for
+ * MAX of them, in one go rather than a copyin per pointer. The count
+ * not including the terminator is stored in *COUNT. Returns E2BIG if
+ * there's no terminator among the first MAX entries.
+ */
+int
+copyinptrs(const_userptr_t usersrc, userptr_t *dest, size_t max,
+	   size_t *count)
+{
+	int result;
+	size_t stoplen, i, n;
+	const userptr_t *src;
+
+	if ((vaddr_t)usersrc % sizeof(userptr_t) != 0) {
+		return EFAULT;
+	}
+	result = copycheck(usersrc, max * sizeof(userptr_t), &stoplen);
+	if (result) {
+		return result;
+	}
+	n = stoplen / sizeof(userptr_t);
+
+	curthread->t_machdep.tm_badfaultfunc = copyfail;
+
+	result = setjmp(curthread->t_machdep.tm_copyjmp);
+	if (result) {
+		curthread->t_machdep.tm_badfaultfunc = NULL;
+		return EFAULT;
+	}
+
+	src = (const userptr_t *)usersrc;
+	for (i=0; i<n; i++) {
+		dest[i] = src[i];
+		if (dest[i] == NULL) {
+			break;
+		}
+	}
+
+	curthread->t_machdep.tm_badfaultfunc = NULL;
+
+	if (i == n) {
+		/* ran into the kernel, or out of room */
+		return n < max ? EFAULT : E2BIG;
+	}
+	*count = i;
+	return 0;
+}
@@ -30,6 +30,8 @@
 #include <types.h>
 #include <lib.h>
 #include <spinlock.h>
+#include <lockstat.h>
+#include <counter.h>
 #include <vm.h>
 
 /*
@@ -163,10 +165,14 @@ struct pageref {
  * Use one spinlock for the whole thing. Making parts of the kmalloc
  * logic per-cpu is worthwhile for scalability; however, for the time
  * being at least we won't, because it adds a lot of complexity and in
- * OS/161 performance and scalability aren't super-critical.
+ * OS/161 performance and scalability aren't super-critical. It is a
+ * ticket lock, though, so no cpu gets starved when they all pile in.
  */
 
-static struct spinlock kmalloc_spinlock = SPINLOCK_INITIALIZER;
+static struct lockstat kmalloc_lockstat = LOCKSTAT_INITIALIZER("kmalloc");
+static struct counter kmalloc_counter = COUNTER_INITIALIZER("kmalloc");
+static struct spinlock kmalloc_spinlock =
+	SPINLOCK_INITIALIZER_TICKET(&kmalloc_lockstat);
 
 ////////////////////////////////////////
 
@@ -1178,6 +1184,8 @@ kmalloc(size_t sz)
 #endif /* __GNUC__ */
 #endif /* LABELS */
 
+	counter_inc(&kmalloc_counter);
+
 	checksz = sz + GUARD_OVERHEAD + LABEL_OVERHEAD;
 	if (checksz >= LARGEST_SUBPAGE_SIZE) {
 		unsigned long npages;
@@ -0,0 +1,46 @@
+#ifndef _SYS_FUTEX_H_
+#define _SYS_FUTEX_H_
+
+/*
+ * Get FUTEX_WAIT and FUTEX_WAKE from the kernel
+ */
+#include <kern/futex.h>
+
+/*
+ * The raw system call. For FUTEX_WAIT returns 0 once woken, or -1 with
+ * errno EAGAIN if *uaddr didn't hold val. For FUTEX_WAKE returns the
+ * number of sleepers woken.
+ */
+int futex(volatile int *uaddr, int op, int val);
+
+/*
+ * Mutex and counting semaphore built on futex(). Taking an available
+ * mutex or semaphore, or releasing one nobody is waiting for, is done
+ * with atomic operations in userspace and makes no system call.
+ *
+ * Both are plain ints in memory and can be initialized statically:
+ * a mutex to FUTEX_MUTEX_INITIALIZER, a semaphore to its count. To be
+ * shared between processes they must live in memory both can see.
+ */
+struct futex_mutex {
+	volatile int fm_state;	/* 0 free, 1 held, 2 held with waiters */
+};
+
+struct futex_sem {
+	volatile int fs_count;	/* available units */
+	volatile int fs_waiters; /* threads blocked in futex_sem_P */
+};
+
+#define FUTEX_MUTEX_INITIALIZER	{ 0 }
+#define FUTEX_SEM_INITIALIZER(n)	{ (n), 0 }
+
+void futex_mutex_init(struct futex_mutex *m);
+void futex_mutex_lock(struct futex_mutex *m);
+int futex_mutex_trylock(struct futex_mutex *m);	/* 0 on success */
+void futex_mutex_unlock(struct futex_mutex *m);
+
+void futex_sem_init(struct futex_sem *s, int count);
+void futex_sem_P(struct futex_sem *s);
+void futex_sem_V(struct futex_sem *s);
+
+#endif /* _SYS_FUTEX_H_ */
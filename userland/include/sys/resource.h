@@ -0,0 +1,27 @@
+#ifndef _SYS_RESOURCE_H_
+#define _SYS_RESOURCE_H_
+
+/*
+ * Get struct rusage and all the #defines from the kernel
+ */
+#include <sys/types.h>
+#include <kern/time.h>
+#include <kern/resource.h>
+
+/*
+ * Retrieve resource usage for the current process (RUSAGE_SELF) or
+ * for all of its children that have been waited for
+ * (RUSAGE_CHILDREN).
+ */
+int getrusage(int who, struct rusage *usage);
+
+/*
+ * Get or set the scheduling priority (nice value, PRIO_MIN to
+ * PRIO_MAX, lower is better) of a process. Only PRIO_PROCESS is
+ * supported; who == 0 means the calling process. Because a priority
+ * can legitimately be -1, check errno to detect getpriority failure.
+ */
+int getpriority(int which, int who);
+int setpriority(int which, int who, int prio);
+
+#endif /* _SYS_RESOURCE_H_ */
@@ -0,0 +1,33 @@
+#ifndef _SYS_SYSRING_H_
+#define _SYS_SYSRING_H_
+
+#include <sys/types.h>
+
+/*
+ * Get struct sysring and friends from the kernel
+ */
+#include <kern/sysring.h>
+
+/*
+ * The raw system call: run up to to_submit queued calls. Returns the
+ * number run, or -1 with errno set if the ring is bad.
+ */
+int sysring_enter(struct sysring *ring, unsigned to_submit);
+
+/*
+ * Helpers. sysring_init sets up RING over caller-supplied arrays of
+ * ENTRIES (a power of 2) submissions and completions. sysring_get_sqe
+ * returns the next free submission slot, or NULL if the ring is full;
+ * fill it in and call sysring_submit to run everything queued so far.
+ * sysring_peek_cqe returns the oldest unconsumed completion, or NULL if
+ * there is none, without entering the kernel; sysring_cqe_seen
+ * consumes it.
+ */
+void sysring_init(struct sysring *ring, struct sysring_sqe *sqes,
+		  struct sysring_cqe *cqes, unsigned entries);
+struct sysring_sqe *sysring_get_sqe(struct sysring *ring);
+int sysring_submit(struct sysring *ring);
+struct sysring_cqe *sysring_peek_cqe(struct sysring *ring);
+void sysring_cqe_seen(struct sysring *ring);
+
+#endif /* _SYS_SYSRING_H_ */
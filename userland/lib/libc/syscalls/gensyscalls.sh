@@ -16,6 +16,8 @@ awk '
     # And, do not read lines that do not match the approximate right pattern.
     look && /^#define SYS_/ && NF==3 {
 	sub("^SYS_", "", $2);
+	# getpid is answered from the kinfo page instead (unix/getpid.c).
+	if ($2 == "getpid") next;
 	# print the name of the call and the number.
 	print $2, $3;
     }
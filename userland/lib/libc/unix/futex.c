@@ -0,0 +1,171 @@
+#include <sys/futex.h>
+
+/*
+ * Userlevel mutex and semaphore on top of the futex() system call.
+ *
+ * The mutex is the classic three-state futex mutex: 0 is free, 1 is
+ * held, and 2 is held with (possibly) someone sleeping. Only the
+ * transitions into or out of state 2 enter the kernel.
+ */
+
+/*
+ * Atomic compare-and-swap: if *p == old, store new. Returns the value
+ * *p had. Uses LL/SC; there must be no other memory accesses between
+ * the two, so they're in one asm statement.
+ */
+static
+int
+atomic_cas(volatile int *p, int old, int new)
+{
+	int x, y;
+
+	do {
+		__asm volatile(
+			".set push;"		/* save assembler mode */
+			".set mips32;"		/* allow MIPS32 instructions */
+			".set volatile;"	/* avoid unwanted optimization */
+			".set noreorder;"	/* we fill the delay slot */
+			"ll %0, 0(%2);"		/*   x = *p */
+			"bne %0, %3, 1f;"	/*   if (x != old) give up */
+			"li %1, 1;"		/*   (delay slot) y = success */
+			"move %1, %4;"		/*   y = new */
+			"sc %1, 0(%2);"		/*   *p = y; y = success? */
+			"1:"
+			".set pop"		/* restore assembler mode */
+			: "=&r" (x), "=&r" (y)
+			: "r" (p), "r" (old), "r" (new)
+			: "memory");
+	} while (y == 0);
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 instructions */
+		"sync;"			/* memory barrier */
+		".set pop"		/* restore assembler mode */
+		::: "memory");
+	return x;
+}
+
+/*
+ * Atomically add DELTA to *p; returns the old value.
+ */
+static
+int
+atomic_add(volatile int *p, int delta)
+{
+	int old;
+
+	do {
+		old = *p;
+	} while (atomic_cas(p, old, old + delta) != old);
+	return old;
+}
+
+/*
+ * Atomically store VAL in *p; returns the old value.
+ */
+static
+int
+atomic_swap(volatile int *p, int val)
+{
+	int old;
+
+	do {
+		old = *p;
+	} while (atomic_cas(p, old, val) != old);
+	return old;
+}
+
+////////////////////////////////////////////////////////////
+// mutex
+
+void
+futex_mutex_init(struct futex_mutex *m)
+{
+	m->fm_state = 0;
+}
+
+int
+futex_mutex_trylock(struct futex_mutex *m)
+{
+	return atomic_cas(&m->fm_state, 0, 1) == 0 ? 0 : -1;
+}
+
+void
+futex_mutex_lock(struct futex_mutex *m)
+{
+	int c;
+
+	c = atomic_cas(&m->fm_state, 0, 1);
+	if (c == 0) {
+		/* fast path: it was free */
+		return;
+	}
+
+	/*
+	 * Mark it contended and sleep until we're the one that finds
+	 * it free. We may set 2 when nobody else is waiting anymore;
+	 * that just costs an unneeded wakeup call at unlock.
+	 */
+	if (c != 2) {
+		c = atomic_swap(&m->fm_state, 2);
+	}
+	while (c != 0) {
+		futex(&m->fm_state, FUTEX_WAIT, 2);
+		c = atomic_swap(&m->fm_state, 2);
+	}
+}
+
+void
+futex_mutex_unlock(struct futex_mutex *m)
+{
+	if (atomic_add(&m->fm_state, -1) != 1) {
+		/* was 2: someone may be asleep */
+		m->fm_state = 0;
+		futex(&m->fm_state, FUTEX_WAKE, 1);
+	}
+}
+
+////////////////////////////////////////////////////////////
+// semaphore
+
+void
+futex_sem_init(struct futex_sem *s, int count)
+{
+	s->fs_count = count;
+	s->fs_waiters = 0;
+}
+
+void
+futex_sem_P(struct futex_sem *s)
+{
+	int c;
+
+	while (1) {
+		c = s->fs_count;
+		if (c > 0) {
+			if (atomic_cas(&s->fs_count, c, c - 1) == c) {
+				return;
+			}
+			continue;
+		}
+
+		/*
+		 * Count is zero. Register as a waiter first so a V
+		 * that comes after this knows to wake us; if a V got
+		 * in before, the count is no longer 0 and the wait
+		 * returns immediately.
+		 */
+		atomic_add(&s->fs_waiters, 1);
+		futex(&s->fs_count, FUTEX_WAIT, 0);
+		atomic_add(&s->fs_waiters, -1);
+	}
+}
+
+void
+futex_sem_V(struct futex_sem *s)
+{
+	atomic_add(&s->fs_count, 1);
+	if (s->fs_waiters > 0) {
+		futex(&s->fs_count, FUTEX_WAKE, 1);
+	}
+}
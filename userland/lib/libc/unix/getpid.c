@@ -0,0 +1,18 @@
+#include <unistd.h>
+#include <kern/kinfo.h>
+
+/*
+ * POSIX C function: get the process id.
+ *
+ * The kernel maps this process's pid into the kinfo page, so there's
+ * no need for a system call (and no SYS_getpid stub is generated; see
+ * syscalls/gensyscalls.sh).
+ */
+
+pid_t
+getpid(void)
+{
+	const struct kinfo_proc *kp = (const struct kinfo_proc *)KINFO_PROC;
+
+	return kp->kp_pid;
+}
@@ -0,0 +1,55 @@
+#include <unistd.h>
+#include <sys/sysring.h>
+
+/*
+ * Userlevel side of the batched system call ring. See <sys/sysring.h>.
+ */
+
+void
+sysring_init(struct sysring *ring, struct sysring_sqe *sqes,
+	     struct sysring_cqe *cqes, unsigned entries)
+{
+	ring->sr_sqhead = ring->sr_sqtail = 0;
+	ring->sr_cqhead = ring->sr_cqtail = 0;
+	ring->sr_entries = entries;
+	ring->sr_sqes = sqes;
+	ring->sr_cqes = cqes;
+}
+
+/*
+ * Claim the next submission slot. It counts as queued right away, so
+ * fill it in before the next sysring_submit.
+ */
+struct sysring_sqe *
+sysring_get_sqe(struct sysring *ring)
+{
+	struct sysring_sqe *sqe;
+
+	if (ring->sr_sqtail - ring->sr_sqhead == ring->sr_entries) {
+		return NULL;
+	}
+	sqe = &ring->sr_sqes[ring->sr_sqtail & (ring->sr_entries - 1)];
+	ring->sr_sqtail++;
+	return sqe;
+}
+
+int
+sysring_submit(struct sysring *ring)
+{
+	return sysring_enter(ring, ring->sr_sqtail - ring->sr_sqhead);
+}
+
+struct sysring_cqe *
+sysring_peek_cqe(struct sysring *ring)
+{
+	if (ring->sr_cqhead == ring->sr_cqtail) {
+		return NULL;
+	}
+	return &ring->sr_cqes[ring->sr_cqhead & (ring->sr_entries - 1)];
+}
+
+void
+sysring_cqe_seen(struct sysring *ring)
+{
+	ring->sr_cqhead++;
+}
@@ -0,0 +1,145 @@
+/*
+ * futextest - test the futex() system call and the libc futex_mutex
+ * and futex_sem built on it.
+ *
+ * Only the parts that don't block can be checked here: a FUTEX_WAIT
+ * that would sleep needs another thread or process to wake it through
+ * the same memory, and processes share no writable memory yet.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/futex.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+#include <err.h>
+
+/*
+ * FUTEX_WAIT on a word that doesn't hold the expected value must fail
+ * with EAGAIN rather than sleep, and a FUTEX_WAKE with nobody waiting
+ * wakes nobody.
+ */
+static
+void
+test_eagain(void)
+{
+	volatile int word = 5;
+	int r;
+
+	printf("futextest: EAGAIN on a changed value...\n");
+	r = futex(&word, FUTEX_WAIT, 6);
+	if (r != -1) {
+		errx(1, "FUTEX_WAIT on a changed value returned %d", r);
+	}
+	if (errno != EAGAIN) {
+		err(1, "FUTEX_WAIT on a changed value");
+	}
+
+	r = futex(&word, FUTEX_WAKE, 1);
+	if (r != 0) {
+		errx(1, "FUTEX_WAKE with no waiters returned %d", r);
+	}
+}
+
+/*
+ * After fork each process has its own copy of the futex word, at the
+ * same address but in different physical memory. The child changes
+ * its copy and must get EAGAIN waiting for the old value; the parent's
+ * copy must be unaffected, so the parent gets EAGAIN waiting for the
+ * child's value. Neither may find a sleeper to wake at that address.
+ */
+static
+void
+test_fork(void)
+{
+	volatile int word = 0;
+	int pid, status, r;
+
+	printf("futextest: private futex words across fork...\n");
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		word = 1;
+		r = futex(&word, FUTEX_WAIT, 0);
+		if (r != -1 || errno != EAGAIN) {
+			errx(1, "child: FUTEX_WAIT on its changed copy "
+			     "returned %d", r);
+		}
+		r = futex(&word, FUTEX_WAKE, 1);
+		if (r != 0) {
+			errx(1, "child: FUTEX_WAKE woke %d", r);
+		}
+		_exit(0);
+	}
+
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		errx(1, "child failed (status %d)", status);
+	}
+	if (word != 0) {
+		errx(1, "child's store reached the parent's word");
+	}
+	r = futex(&word, FUTEX_WAIT, 1);
+	if (r != -1 || errno != EAGAIN) {
+		errx(1, "FUTEX_WAIT for the child's value returned %d", r);
+	}
+	r = futex(&word, FUTEX_WAKE, 1);
+	if (r != 0) {
+		errx(1, "FUTEX_WAKE woke %d", r);
+	}
+}
+
+/*
+ * Uncontended mutex and semaphore operations. (Contending on them
+ * needs memory shared between processes, which we don't have.)
+ */
+static
+void
+test_mutex_sem(void)
+{
+	struct futex_mutex m;
+	struct futex_sem s;
+
+	printf("futextest: futex_mutex and futex_sem...\n");
+
+	futex_mutex_init(&m);
+	if (futex_mutex_trylock(&m) != 0) {
+		errx(1, "trylock of a free mutex failed");
+	}
+	if (futex_mutex_trylock(&m) == 0) {
+		errx(1, "trylock of a held mutex succeeded");
+	}
+	futex_mutex_unlock(&m);
+	if (m.fm_state != 0) {
+		errx(1, "mutex state %d after unlock", m.fm_state);
+	}
+	futex_mutex_lock(&m);
+	futex_mutex_unlock(&m);
+
+	futex_sem_init(&s, 2);
+	futex_sem_P(&s);
+	futex_sem_P(&s);
+	if (s.fs_count != 0) {
+		errx(1, "semaphore count %d after two P", s.fs_count);
+	}
+	futex_sem_V(&s);
+	if (s.fs_count != 1 || s.fs_waiters != 0) {
+		errx(1, "semaphore count %d, waiters %d after V",
+		     s.fs_count, s.fs_waiters);
+	}
+}
+
+int
+main(void)
+{
+	test_eagain();
+	test_fork();
+	test_mutex_sem();
+	printf("futextest: passed\n");
+	return 0;
+}
@@ -0,0 +1,220 @@
+/*
+ * sysringtest - test batched system calls through sysring_enter.
+ *
+ * Runs a batch mixing getpid and waitpid (including one that fails),
+ * checks that a call that can't be batched (fork) comes back with
+ * ENOSYS, and checks that a full completion ring stops a batch early
+ * with the rest left queued.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/sysring.h>
+#include <kern/syscall.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+#include <err.h>
+
+#define NENTRIES 8
+
+static struct sysring ring;
+static struct sysring_sqe sqes[NENTRIES];
+static struct sysring_cqe cqes[NENTRIES];
+
+/*
+ * Queue one call.
+ */
+static
+void
+queue(int callno, int a0, int a1, int a2, unsigned data)
+{
+	struct sysring_sqe *sqe;
+
+	sqe = sysring_get_sqe(&ring);
+	if (sqe == NULL) {
+		errx(1, "submission ring full");
+	}
+	sqe->sqe_callno = callno;
+	sqe->sqe_args[0] = a0;
+	sqe->sqe_args[1] = a1;
+	sqe->sqe_args[2] = a2;
+	sqe->sqe_args[3] = 0;
+	sqe->sqe_data = data;
+}
+
+/*
+ * Take the next completion and check it.
+ */
+static
+void
+expect(unsigned data, int result, int error)
+{
+	struct sysring_cqe *cqe;
+
+	cqe = sysring_peek_cqe(&ring);
+	if (cqe == NULL) {
+		errx(1, "no completion for %u", data);
+	}
+	if (cqe->cqe_data != data) {
+		errx(1, "completion for %u where %u was expected",
+		     cqe->cqe_data, data);
+	}
+	if (cqe->cqe_result != result || cqe->cqe_errno != error) {
+		errx(1, "%u: result %d errno %d, expected %d and %d", data,
+		     cqe->cqe_result, cqe->cqe_errno, result, error);
+	}
+	sysring_cqe_seen(&ring);
+}
+
+static
+void
+submit(int expected)
+{
+	int n;
+
+	n = sysring_submit(&ring);
+	if (n < 0) {
+		err(1, "sysring_enter");
+	}
+	if (n != expected) {
+		errx(1, "sysring_enter ran %d calls, expected %d", n, expected);
+	}
+}
+
+static
+int
+spawn(int code)
+{
+	int pid;
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		_exit(code);
+	}
+	return pid;
+}
+
+/*
+ * getpid and waitpid, with a waitpid that fails in the middle.
+ */
+static
+void
+test_batch(void)
+{
+	int pid1, pid2, status1, status2, status3;
+	int mypid;
+
+	printf("sysringtest: getpid/waitpid batch...\n");
+	mypid = getpid();
+	pid1 = spawn(11);
+	pid2 = spawn(12);
+
+	queue(SYS_getpid, 0, 0, 0, 100);
+	queue(SYS_waitpid, pid1, (int)&status1, 0, 101);
+	queue(SYS_waitpid, pid2, (int)&status2, 0, 102);
+	queue(SYS_waitpid, WAIT_ANY, (int)&status3, WNOHANG, 103);
+	queue(SYS_getpid, 0, 0, 0, 104);
+	submit(5);
+
+	expect(100, mypid, 0);
+	expect(101, pid1, 0);
+	expect(102, pid2, 0);
+	expect(103, -1, ECHILD);
+	expect(104, mypid, 0);
+	if (sysring_peek_cqe(&ring) != NULL) {
+		errx(1, "extra completion");
+	}
+
+	if (!WIFEXITED(status1) || WEXITSTATUS(status1) != 11) {
+		errx(1, "child 1 status %d", status1);
+	}
+	if (!WIFEXITED(status2) || WEXITSTATUS(status2) != 12) {
+		errx(1, "child 2 status %d", status2);
+	}
+}
+
+/*
+ * fork can't be batched; it must fail without creating a process.
+ */
+static
+void
+test_nobatch(void)
+{
+	int status;
+
+	printf("sysringtest: fork in a batch...\n");
+	queue(SYS_fork, 0, 0, 0, 200);
+	queue(SYS_getpid, 0, 0, 0, 201);
+	submit(2);
+	expect(200, -1, ENOSYS);
+	expect(201, getpid(), 0);
+
+	if (waitpid(WAIT_ANY, &status, WNOHANG) >= 0 || errno != ECHILD) {
+		errx(1, "batched fork created a child");
+	}
+}
+
+/*
+ * With completions left unconsumed, a batch stops when the completion
+ * ring fills, and what's left stays queued for next time.
+ */
+static
+void
+test_cqfull(void)
+{
+	unsigned i;
+	int mypid;
+
+	printf("sysringtest: full completion ring...\n");
+	mypid = getpid();
+
+	for (i=0; i<NENTRIES/2; i++) {
+		queue(SYS_getpid, 0, 0, 0, 300 + i);
+	}
+	submit(NENTRIES/2);
+
+	/* Leave those completions where they are. */
+	for (i=0; i<NENTRIES; i++) {
+		queue(SYS_getpid, 0, 0, 0, 400 + i);
+	}
+	submit(NENTRIES/2);
+	if (ring.sr_sqtail - ring.sr_sqhead != NENTRIES/2) {
+		errx(1, "%u submissions left queued, expected %u",
+		     ring.sr_sqtail - ring.sr_sqhead, NENTRIES/2);
+	}
+	if (ring.sr_cqtail - ring.sr_cqhead != NENTRIES) {
+		errx(1, "%u completions, expected %u",
+		     ring.sr_cqtail - ring.sr_cqhead, NENTRIES);
+	}
+
+	for (i=0; i<NENTRIES/2; i++) {
+		expect(300 + i, mypid, 0);
+	}
+	for (i=0; i<NENTRIES/2; i++) {
+		expect(400 + i, mypid, 0);
+	}
+
+	/* Now there's room for the rest. */
+	submit(NENTRIES/2);
+	for (i=NENTRIES/2; i<NENTRIES; i++) {
+		expect(400 + i, mypid, 0);
+	}
+	if (sysring_peek_cqe(&ring) != NULL) {
+		errx(1, "extra completion");
+	}
+}
+
+int
+main(void)
+{
+	sysring_init(&ring, sqes, cqes, NENTRIES);
+	test_batch();
+	test_nobatch();
+	test_cqfull();
+	printf("sysringtest: passed\n");
+	return 0;
+}